@@ -118,30 +118,54 @@ void SyncVarBase::setOutOfDate()
     upToDate = false;
 }
 
+/**
+ * @brief Construct a SyncVar or a SyncVarArray, depending on the size.
+ * @param index index of the SyncVar, as defined by the board.
+ * @param name user-readable name of the SyncVar.
+ * @param access access rights for this variable.
+ * @param size size of the SyncVar value, as defined by the board [byte].
+ * @return A pointer to the constructed SyncVar, or nullptr if the size is not
+ * a multiple of the type size.
+ */
+template<typename T>
+static SyncVarBase *makeTypedSyncVar(int index, QString name,
+                                     VarAccess access, int size)
+{
+    if(size == (int)sizeof(T))
+        return new SyncVar<T>(index, name, access, sizeof(T));
+    else if(size > 0 && size % (int)sizeof(T) == 0)
+        return new SyncVarArray<T>(index, name, access, size / (int)sizeof(T));
+    else
+        return nullptr;
+}
+
 /**
  * @brief Construct a SyncVar object with the given characteristics.
  * @param type type of the SyncVar.
  * @param index index of the SyncVar, as defined by the board.
  * @param name user-readable name of the SyncVar.
  * @param access access rights for this variable.
- * @return A pointer to the constructed SyncVar.
+ * @param size size of the SyncVar value, as defined by the board [byte]. If
+ * it is a multiple of the type size, a SyncVarArray is constructed.
+ * @return A pointer to the constructed SyncVar, or nullptr if the type or the
+ * size is invalid.
  */
 SyncVarBase *makeSyncVar(VarType type, int index, QString name,
-                         VarAccess access)
+                         VarAccess access, int size)
 {
     switch(type)
     {
-    case BOOL: return new SyncVar<bool>(index, name, access, 1);
-    case UINT8: return new SyncVar<uint8_t>(index, name, access, 1);
-    case INT8: return new SyncVar<int8_t>(index, name, access, 1);
-    case UINT16: return new SyncVar<uint16_t>(index, name, access, 2);
-    case INT16: return new SyncVar<int16_t>(index, name, access, 2);
-    case UINT32: return new SyncVar<uint32_t>(index, name, access, 4);
-    case INT32: return new SyncVar<int32_t>(index, name, access, 4);
-    case UINT64: return new SyncVar<uint64_t>(index, name, access, 8);
-    case INT64: return new SyncVar<int64_t>(index, name, access, 8);
-    case FLOAT32: return new SyncVar<float>(index, name, access, 4);
-    case FLOAT64: return new SyncVar<double>(index, name, access, 8);
+    case BOOL: return makeTypedSyncVar<bool>(index, name, access, size);
+    case UINT8: return makeTypedSyncVar<uint8_t>(index, name, access, size);
+    case INT8: return makeTypedSyncVar<int8_t>(index, name, access, size);
+    case UINT16: return makeTypedSyncVar<uint16_t>(index, name, access, size);
+    case INT16: return makeTypedSyncVar<int16_t>(index, name, access, size);
+    case UINT32: return makeTypedSyncVar<uint32_t>(index, name, access, size);
+    case INT32: return makeTypedSyncVar<int32_t>(index, name, access, size);
+    case UINT64: return makeTypedSyncVar<uint64_t>(index, name, access, size);
+    case INT64: return makeTypedSyncVar<int64_t>(index, name, access, size);
+    case FLOAT32: return makeTypedSyncVar<float>(index, name, access, size);
+    case FLOAT64: return makeTypedSyncVar<double>(index, name, access, size);
     default: return nullptr;
     }
 }
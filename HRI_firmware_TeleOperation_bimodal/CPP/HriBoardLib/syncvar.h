@@ -21,6 +21,9 @@
 #include <limits>
 #include <QString>
 #include <QList>
+#include <QVector>
+#include <QStringList>
+#include <algorithm>
 
 #include "../../Firmware/src/definitions.h"
 typedef comm_VarType VarType;
@@ -51,6 +54,15 @@ public:
     bool isUpToDate() const;
     void setOutOfDate();
 
+    /**
+     * @brief Gets the number of values held by the SyncVar.
+     * @return 1 for a scalar SyncVar, the number of elements for an array.
+     */
+    virtual int getLength() const
+    {
+        return 1;
+    }
+
     /**
      * @brief Gets the variable value, as a floating-point number.
      * @return The variable value, casted to the double type.
@@ -203,8 +215,114 @@ protected:
     T value;
 };
 
+/**
+ * @brief Array of values that can be synchronized with its HRI board
+ * counterpart, as a single SyncVar.
+ *
+ * The board declares an array SyncVar like a scalar one, but with a size that
+ * is a multiple of the size of the element type. The whole array is
+ * transferred at once, so all the values are consistent.
+ */
+template<typename T>
+class SyncVarArray : public SyncVarBase
+{
+public:
+    SyncVarArray(int index, QString name, VarAccess access, int length) :
+        SyncVarArray(index, name, access, length, new T[length]())
+    {
+
+    }
+
+    SyncVarArray(const SyncVarArray&) = delete;
+    SyncVarArray& operator=(const SyncVarArray&) = delete;
+
+    ~SyncVarArray()
+    {
+        delete[] values;
+    }
+
+    int getLength() const override
+    {
+        return length;
+    }
+
+    T getLocalValue(int i) const
+    {
+        return values[i];
+    }
+
+    QVector<T> getLocalValues() const
+    {
+        return QVector<T>(values, values + length);
+    }
+
+    /**
+     * @brief Gets the first element of the array, as a floating-point number.
+     * @return The first element, casted to the double type.
+     */
+    double toDouble() const override
+    {
+        return (double)values[0];
+    }
+
+    QString toString() const override
+    {
+        QStringList texts;
+
+        for(int i=0; i<length; i++)
+            texts.append(QString::number(values[i]));
+
+        return texts.join(" ");
+    }
+
+    void fromDouble(double value) override
+    {
+        for(int i=0; i<length; i++)
+            values[i] = (T)value;
+    }
+
+    /**
+     * @brief Sets all the elements from a string of space-separated numbers.
+     * @param text the new values. The number of values must match the array
+     * length, and each one must be valid for the element type.
+     * @return true if the text was valid, false otherwise.
+     */
+    bool fromString(QString text) override
+    {
+        QStringList texts = text.split(" ", QString::SkipEmptyParts);
+        SyncVar<T> element(0, "", getAccess(), sizeof(T));
+        QVector<T> newValues;
+
+        if(texts.size() != length)
+            return false;
+
+        for(QString t : texts)
+        {
+            if(!element.fromString(t))
+                return false;
+
+            newValues.append(element.getLocalValue());
+        }
+
+        std::copy(newValues.begin(), newValues.end(), values);
+        return true;
+    }
+
+private:
+    SyncVarArray(int index, QString name, VarAccess access, int length,
+                 T *values) :
+        SyncVarBase(index, name, access, (uint8_t*)values, length * sizeof(T)),
+        values(values), length(length)
+    {
+
+    }
+
+    T *const values;
+    const int length;
+};
+
 SyncVarBase* makeSyncVar(VarType type, int index, QString name,
-                         VarAccess access);
+                         VarAccess access, int size);
 
 /**
  * @}
@@ -70,6 +70,10 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->pausePlotButton, SIGNAL(toggled(bool)),
             this, SLOT(onPauseToggled(bool)));
 
+    // The link histograms pane is only shown if the board shares them.
+    linkHistograms = new LinkHistogramsWidget(&hriBoard);
+    ui->splitter->addWidget(linkHistograms);
+
     //
     syncVars = nullptr;
 
@@ -237,6 +241,10 @@ void MainWindow::onVarsListReceived(const QList<SyncVarBase *> &syncVars)
             variablesListLayout->addWidget(varsWidgets.streamCheckbox, i, 4);
             connect(varsWidgets.streamCheckbox, SIGNAL(toggled(bool)),
                     this, SLOT(onStreamCheckboxToggled()));
+
+            // Arrays are too large to be streamed.
+            if(syncVars[i]->getLength() > 1)
+                varsWidgets.streamCheckbox->setEnabled(false);
         }
 
         if(syncVars[i]->getAccess() != WRITEONLY)
@@ -251,6 +259,17 @@ void MainWindow::onVarsListReceived(const QList<SyncVarBase *> &syncVars)
         syncVarsWidgets.append(varsWidgets);
     }
 
+    // Show the link histograms, if the board has them.
+    SyncVarBase *histogramsVar = nullptr;
+
+    for(SyncVarBase *sv : syncVars)
+    {
+        if(sv->getName() == LINK_HISTOGRAMS_VAR_NAME)
+            histogramsVar = sv;
+    }
+
+    linkHistograms->setSyncVar(histogramsVar);
+
     // Acquire the value of all the readable SyncVars.
     for(SyncVarBase *sv : syncVars)
     {
@@ -15,14 +15,25 @@
  */
 
 #include "adc.h"
-#include "../lib/basic_filter.h"
+#include "callback_timers.h"
 #include "../lib/utils.h"
 
+#define ADC_CURRENT_FILTER_CUTOFF 170.0f // Default cut-off frequency of the current low-pass filter [Hz].
+
+#define ADC_SCAN_TIMER_PRESCALER ((uint16_t)(SystemCoreClock/APB1_PRESCALER*TIM_MULTIPLIER/1000000-1)) // CLK_CNT = 1[us].
+
 volatile uint16_t adc_currentValuesBuffer[ADC_BUFFER_SIZE];
-bfilt_BasicFilter adc_currentFilter;
+volatile int32_t adc_currentBlockSum; // Sum of the samples of the last complete half of the buffer.
+volatile int32_t adc_currentSum; // Sum of the samples of the last two complete halves of the buffer.
+bool adc_synchronousSampling = false; // true to use the current sampled in the middle of the PWM pulse, false to use the average of the buffer.
+volatile uint16_t adc_channelValues[ADC_N_SCANNED_CHANNELS]; // Last values of the Hall and ANIN1-4 channels, in the scan order.
+bqf_Filter adc_currentFilter;
 float32_t adc_currentSensOffset = 0.0f;
+float32_t adc_unfilteredCurrent = 0.0f; // Last current computed by adc_GetCurrent(), before the filter [A].
 
 void adc_DmaInit(void);
+void adc_ScanTimerInit(void);
+int adc_GetScanIndex(AdcChannel channel);
 
 /**
   * @brief  Initialize the ADC converter (2 analog inputs + current sense).
@@ -69,32 +80,56 @@ void adc_Init(void)
     ADC_CommonInit(&ADC_CommonInitStructure);
 
     // ADC 1 configuration for general purpose.
+    // The Hall and ANIN1-4 channels are converted in sequence at each TIM4
+    // trigger, and copied to adc_channelValues by the DMA.
     ADC_InitStructure.ADC_Resolution           = ADC_Resolution_12b;
-    ADC_InitStructure.ADC_ScanConvMode         = DISABLE;
+    ADC_InitStructure.ADC_ScanConvMode         = ENABLE;
     ADC_InitStructure.ADC_ContinuousConvMode   = DISABLE;
-    ADC_InitStructure.ADC_ExternalTrigConvEdge = ADC_ExternalTrigConvEdge_None;
-    ADC_InitStructure.ADC_ExternalTrigConv     = 0;
+    ADC_InitStructure.ADC_ExternalTrigConvEdge = ADC_ExternalTrigConvEdge_Rising;
+    ADC_InitStructure.ADC_ExternalTrigConv     = ADC_ExternalTrigConv_T4_CC4;
     ADC_InitStructure.ADC_DataAlign            = ADC_DataAlign_Right;
-    ADC_InitStructure.ADC_NbrOfConversion      = 1;
+    ADC_InitStructure.ADC_NbrOfConversion      = ADC_N_SCANNED_CHANNELS;
     ADC_Init(ADC1, &ADC_InitStructure);
     
     ADC_RegularChannelConfig(ADC1, ADC_HALL_CHANNEL, 1, ADC_SampleTime_56Cycles);
+    ADC_RegularChannelConfig(ADC1, ADC_ANIN1_CHANNEL, 2, ADC_SampleTime_56Cycles);
+    ADC_RegularChannelConfig(ADC1, ADC_ANIN2_CHANNEL, 3, ADC_SampleTime_56Cycles);
+    ADC_RegularChannelConfig(ADC1, ADC_ANIN3_CHANNEL, 4, ADC_SampleTime_56Cycles);
+    ADC_RegularChannelConfig(ADC1, ADC_ANIN4_CHANNEL, 5, ADC_SampleTime_56Cycles);
+    ADC_DMARequestAfterLastTransferCmd(ADC1, ENABLE);
+    ADC_DMACmd(ADC1, ENABLE);
     ADC_Cmd(ADC1, ENABLE);
-    ADC_SoftwareStartConv(ADC1);
 
     // ADC 3 configuration for motor current sensing.
     // Synchronous sampling with the PWM replaced by a high-frequency sampling at ~300kHz (over-sampling), because of the commutation noise of the current measuring amplifier at ~120kHz.
-    ADC_InitStructure.ADC_ContinuousConvMode = ENABLE;       
+    ADC_InitStructure.ADC_ScanConvMode         = DISABLE;
+    ADC_InitStructure.ADC_ContinuousConvMode   = ENABLE;
+    ADC_InitStructure.ADC_ExternalTrigConvEdge = ADC_ExternalTrigConvEdge_None;
+    ADC_InitStructure.ADC_ExternalTrigConv     = 0;
+    ADC_InitStructure.ADC_NbrOfConversion      = 1;
     ADC_Init(ADC3, &ADC_InitStructure);   
 
     ADC_RegularChannelConfig(ADC3, ADC_CURRENT_SENSE_CHANNEL, 1, ADC_SampleTime_28Cycles);
+
+    // The current is also sampled in the middle of each PWM pulse, by an
+    // injected conversion triggered by the channel 4 of the PWM timer (TIM8).
+    // This sample is only used if selected with adc_SetSynchronousSampling(),
+    // since it is exposed to the amplifier commutation noise.
+    ADC_InjectedSequencerLengthConfig(ADC3, 1);
+    ADC_InjectedChannelConfig(ADC3, ADC_CURRENT_SENSE_CHANNEL, 1, ADC_SampleTime_28Cycles);
+    ADC_ExternalTrigInjectedConvConfig(ADC3, ADC_ExternalTrigInjecConv_T8_CC4);
+    ADC_ExternalTrigInjectedConvEdgeConfig(ADC3, ADC_ExternalTrigInjecConvEdge_Rising);
     ADC_DMARequestAfterLastTransferCmd(ADC3, ENABLE);
     ADC_DMACmd(ADC3, ENABLE);
     ADC_Cmd(ADC3, ENABLE);
     ADC_SoftwareStartConv(ADC3);
 
+    // Start triggering the conversions of the ADC 1.
+    adc_ScanTimerInit();
+
     // Setup the filter of the ADC current samples over time.
-    bfilt_Init(&adc_currentFilter, 0.05f, 0.0f);
+    bqf_Init(&adc_currentFilter, BQF_LOW_PASS, 1, ADC_CURRENT_FILTER_CUTOFF,
+             0.0f);
 }
 
 /**
@@ -103,6 +138,7 @@ void adc_Init(void)
 void adc_DmaInit(void)
 {
     DMA_InitTypeDef DMA_InitStructure;
+    NVIC_InitTypeDef NVIC_InitStruct;
 
     RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_DMA2, ENABLE);
     
@@ -123,7 +159,57 @@ void adc_DmaInit(void)
     DMA_InitStructure.DMA_Channel            = DMA_Channel_2;
     DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&ADC3->DR;
     DMA_Init(DMA2_Stream1, &DMA_InitStructure);
+
+    // Sum each half of the buffer as soon as it is complete.
+    adc_currentBlockSum = 0;
+    adc_currentSum = 0;
+    DMA_ITConfig(DMA2_Stream1, DMA_IT_HT | DMA_IT_TC, ENABLE);
+
+    NVIC_InitStruct.NVIC_IRQChannel = DMA2_Stream1_IRQn;
+    NVIC_InitStruct.NVIC_IRQChannelPreemptionPriority = CURRENT_SENSE_IRQ_PRIORITY;
+    NVIC_InitStruct.NVIC_IRQChannelSubPriority = 0;
+    NVIC_InitStruct.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_Init(&NVIC_InitStruct);
+
     DMA_Cmd(DMA2_Stream1, ENABLE);
+
+    // ADC 1 (Hall and ANIN1-4).
+    DMA_InitStructure.DMA_Memory0BaseAddr    = (uint32_t)&adc_channelValues;
+    DMA_InitStructure.DMA_BufferSize         = ADC_N_SCANNED_CHANNELS;
+    DMA_InitStructure.DMA_Priority           = DMA_Priority_Medium;
+    DMA_InitStructure.DMA_FIFOMode           = DMA_FIFOMode_Disable;
+    DMA_InitStructure.DMA_Channel            = DMA_Channel_0;
+    DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&ADC1->DR;
+    DMA_Init(DMA2_Stream0, &DMA_InitStructure);
+    DMA_Cmd(DMA2_Stream0, ENABLE);
+}
+
+/**
+  * @brief  Setup TIM4 to trigger the conversions of the ADC 1 periodically.
+  */
+void adc_ScanTimerInit(void)
+{
+    TIM_TimeBaseInitTypeDef TIM_TimeBaseStruct;
+    TIM_OCInitTypeDef       TIM_OCInitStruct;
+
+    RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM4, ENABLE);
+
+    TIM_TimeBaseStructInit(&TIM_TimeBaseStruct);
+    TIM_TimeBaseStruct.TIM_Prescaler     = ADC_SCAN_TIMER_PRESCALER;
+    TIM_TimeBaseStruct.TIM_Period        = ADC_SCAN_PERIOD - 1;
+    TIM_TimeBaseStruct.TIM_ClockDivision = 0;
+    TIM_TimeBaseStruct.TIM_CounterMode   = TIM_CounterMode_Up;
+    TIM_TimeBaseInit(TIM4, &TIM_TimeBaseStruct);
+
+    // The rising edge of the channel 4 (not wired to a pin) triggers the ADC.
+    TIM_OCStructInit(&TIM_OCInitStruct);
+    TIM_OCInitStruct.TIM_OCMode      = TIM_OCMode_PWM1;
+    TIM_OCInitStruct.TIM_OutputState = TIM_OutputState_Enable;
+    TIM_OCInitStruct.TIM_Pulse       = ADC_SCAN_PERIOD / 2;
+    TIM_OCInitStruct.TIM_OCPolarity  = TIM_OCPolarity_High;
+    TIM_OC4Init(TIM4, &TIM_OCInitStruct);
+
+    TIM_Cmd(TIM4, ENABLE);
 }
 
 /**
@@ -151,88 +237,132 @@ void adc_CalibrateCurrentSens(void)
   */
 float32_t adc_GetCurrent(void)
 {
-    int32_t motorCurrentSum;
     float32_t motorCurrentMean;
 
-    int32_t i;
-    
-    // Compute the average of all the ADC values in the buffer.
-    motorCurrentSum = 0; // [ADC raw value].
-
-    for(i=0; i<ADC_BUFFER_SIZE; i++)
-        motorCurrentSum += (int32_t)(adc_currentValuesBuffer[i]);
-    
-    motorCurrentMean = (float32_t)motorCurrentSum / (float32_t)ADC_BUFFER_SIZE;
+    // Get the sample synchronous with the PWM, or compute the average of the
+    // last complete ADC values.
+    if(adc_synchronousSampling)
+        motorCurrentMean = (float32_t)ADC_GetInjectedConversionValue(ADC3, ADC_InjectedChannel_1);
+    else
+        motorCurrentMean = (float32_t)adc_currentSum / (float32_t)ADC_BUFFER_SIZE;
 
     // Convert from ADC increments to a current in [A].
     motorCurrentMean *= ADC_CURRENT_SCALE;
     
     // Add the offset obtained during the sense resistor calibration.
     motorCurrentMean -= (float32_t) adc_currentSensOffset;
+    adc_unfilteredCurrent = motorCurrentMean;
     
     // Use low-pass filtering to reduce the noise.
-    bfilt_Step(&adc_currentFilter, motorCurrentMean);
-    
-    //return motorCurrentMean;
-    return adc_currentFilter.filteredValue;
+    return bqf_Step(&adc_currentFilter, motorCurrentMean,
+                    (float32_t)cbt_GetCurrentLoopPeriod()*MICROSECOND_TO_SECOND);
 }
 
 /**
-  * @brief Start the ADC conversion of the selected channel.
-  * @param channel: the ADC channel to acquire.
+  * @brief Selects the current measurement.
+  * @param synchronous: true to use the current sampled in the middle of the PWM
+  * pulse, false to use the average of the oversampled window.
   */
-void adc_StartConversion(AdcChannel channel)
+void adc_SetSynchronousSampling(bool synchronous)
 {
-    ADC_Cmd(ADC1, DISABLE);
-    ADC_RegularChannelConfig(ADC1, channel, 1, ADC_SampleTime_56Cycles);
-    ADC_Cmd(ADC1, ENABLE);
-    utils_DelayUs(1);
-    ADC_SoftwareStartConv(ADC1);
+    adc_synchronousSampling = synchronous;
 }
 
 /**
-  * @brief Gets the ADC conversion status of the selected channel.
-  * @retval 1 if the conversion is finished, 0 otherwise.
+  * @brief Gets the current measurement in use.
+  * @retval true if the current is sampled in the middle of the PWM pulse, false
+  * if it is the average of the oversampled window.
   */
-bool adc_ConversionIsFinished(void)
+bool adc_GetSynchronousSampling(void)
 {
-    return (ADC1->SR & ADC_SR_EOC) != 0;
+    return adc_synchronousSampling;
 }
 
 /**
-  * @brief Gets the voltage measured by the selected ADC channel.
-  * @return the measured voltage [V].
-  * @note make sure that the conversion is finished before calling.
+  * @brief Gets the last current computed by adc_GetCurrent(), before the
+  * filter, without sampling it again.
+  * @retval The unfiltered current [A].
   */
-float32_t adc_GetConversionResult(void)
+float32_t adc_GetUnfilteredCurrent(void)
 {
-    float32_t adcRawVal, voltage;
-    
-    adcRawVal = (float32_t)ADC1->DR;
-        
-    voltage = (adcRawVal / ADC_MAX) * ADC_REF_VOLTAGE;
- 
-    return voltage;
+    return adc_unfilteredCurrent;
+}
+
+/**
+  * @brief Gets the filter of the motor current.
+  * @retval A pointer to the filter, whose parameters can be modified at any
+  * time.
+  */
+bqf_Filter* adc_GetCurrentFilter(void)
+{
+    return &adc_currentFilter;
+}
+
+/**
+  * @brief Gets the position of the selected channel in the ADC 1 sequence.
+  * @param channel: the channel of the ADC.
+  * @return the index of the channel in adc_channelValues.
+  */
+int adc_GetScanIndex(AdcChannel channel)
+{
+    switch(channel)
+    {
+    case ADC_CHANNEL_9:
+        return 0;
+    case ADC_CHANNEL_6:
+        return 1;
+    case ADC_CHANNEL_7:
+        return 2;
+    case ADC_CHANNEL_14:
+        return 3;
+    case ADC_CHANNEL_15:
+        return 4;
+    default:
+        utils_TrapCpu(); // Channel not converted.
+        return 0;
+    }
 }
 
 /**
   * @brief Gets the voltage measured by the selected ADC channel.
   * @param channel: the channel of the ADC.
-  * @return the measured voltage [V].
+  * @return the last measured voltage [V].
   */
 float32_t adc_GetChannelVoltage(AdcChannel channel)
 {
-    int32_t conversionTime = 0;
-    
-    adc_StartConversion(channel);
-    
-    while(!adc_ConversionIsFinished())
+    float32_t adcRawVal;
+
+    adcRawVal = (float32_t)adc_channelValues[adc_GetScanIndex(channel)];
+
+    return (adcRawVal / ADC_MAX) * ADC_REF_VOLTAGE;
+}
+
+/**
+  * @brief Interrupt from the current sense DMA, when the middle or the end of
+  * the buffer is reached.
+  */
+void DMA2_Stream1_IRQHandler(void)
+{
+    int32_t blockSum = 0;
+    int i, first;
+
+    if(DMA_GetITStatus(DMA2_Stream1, DMA_IT_HTIF1) != RESET)
     {
-        if(conversionTime < ADC_MAX_CONVERSION_TIME)
-            conversionTime++;
-        else
-            break;
+        DMA_ClearITPendingBit(DMA2_Stream1, DMA_IT_HTIF1);
+        first = 0;
     }
+    else if(DMA_GetITStatus(DMA2_Stream1, DMA_IT_TCIF1) != RESET)
+    {
+        DMA_ClearITPendingBit(DMA2_Stream1, DMA_IT_TCIF1);
+        first = ADC_BLOCK_SIZE;
+    }
+    else
+        return;
+
+    // Sum the half that was just completed, while the DMA fills the other one.
+    for(i=first; i<first+ADC_BLOCK_SIZE; i++)
+        blockSum += (int32_t)adc_currentValuesBuffer[i];
 
-    return adc_GetConversionResult();
-}   
+    adc_currentSum = adc_currentBlockSum + blockSum;
+    adc_currentBlockSum = blockSum;
+}
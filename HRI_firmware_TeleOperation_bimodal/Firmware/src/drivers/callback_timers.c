@@ -16,6 +16,7 @@
 
 #include "callback_timers.h"
 
+#include "h_bridge.h"
 #include "../lib/utils.h"
 #include "../torque_regulator.h"
 #include "../haptic_controller.h"
@@ -23,47 +24,71 @@
 #define TE_LOOP_MIN_VALUE 50    // Minimum period for any loop [us].
 #define TE_LOOP_MAX_VALUE 65534 // Maximum period for any loop [us].
 
-#define TE_CURRENT_LOOP_DEFAULT_VAL 50   // Current control loop period [us] (max 2^16-1) (default value at reset).
+#define TE_CURRENT_LOOP_MAX_PWM_PERIODS 128 // Max current loop period, limited by the TIM8 repetition counter [PWM period].
 #define TE_CONTROL_LOOP_DEFAULT_VAL 350  // Main control loop period [us] (max 2^16-1) (default value at reset).
 #define TE_DATA_LOOP_DEFAULT_VAL    1000 // Data loop period [us] (max 2^16-1) (default value at reset).
 
-cbt_PeriodicTaskFunc cbt_tim10Task, cbt_tim6Task, cbt_tim7Task;
+cbt_PeriodicTaskFunc cbt_tim8Task, cbt_tim6Task, cbt_tim7Task;
 volatile float32_t cbt_ucLoad; // Processor load (%).
 
-void tim10InitFunc(void);
+uint32_t cbt_hapticPeriod, cbt_commPeriod; // Requested periods of the haptic controller and communication loops [us].
+volatile uint32_t cbt_hapticDivider, cbt_commDivider; // Periods of the haptic controller and communication loops [current loop tick].
+volatile uint32_t cbt_hapticPhase; // Tick of the haptic controller period, when it is triggered [current loop tick].
+volatile uint32_t cbt_hapticTick; // Current tick in the haptic controller period [current loop tick].
+volatile uint32_t cbt_currentLoopTicks; // Number of current loop ticks since the start.
+uint32_t cbt_nextCommTick; // Value of cbt_currentLoopTicks, when the next communication loop is due.
+
+void tim8InitFunc(void);
 void tim67InitFunc(void);
+void tim2InitFunc(void);
+float32_t cbt_GetCurrentLoopTick(void);
+void cbt_UpdateDividers(void);
 
 /**
   * @brief  Initialize the timers to call an interrupt routine periodically.
   */
 void cbt_Init(void)
 {    
-    // Initialize the timers.
-    tim10InitFunc();
-    tim67InitFunc();
-    
     // Initialize the function pointers to NULL, in order to be able to test
     // if they are already affected or not.
-    cbt_tim10Task = NULL;
+    cbt_tim8Task = NULL;
     cbt_tim6Task = NULL;
     cbt_tim7Task = NULL;
+
+    cbt_hapticPeriod = TE_CONTROL_LOOP_DEFAULT_VAL;
+    cbt_commPeriod = TE_DATA_LOOP_DEFAULT_VAL;
+    cbt_hapticDivider = 1;
+    cbt_commDivider = 1;
+    cbt_hapticPhase = 0;
+    cbt_hapticTick = 0;
+    cbt_currentLoopTicks = 0;
+    cbt_nextCommTick = 0;
+
+    // Initialize the timers.
+    tim8InitFunc();
+    tim67InitFunc();
+    tim2InitFunc();
+
+    // Enable the cycle counter of the core.
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
 }
 
 /**
-  * @brief  Set the function to call periodically by the timer 1.
+  * @brief  Set the function to call periodically by the timer 8 (PWM).
   * @param  f: the function to call periodically.
   * @param  period: the period between each call of f [us].
   */
 void cbt_SetCurrentLoopTimer(cbt_PeriodicTaskFunc f, uint32_t period)
 {
-    cbt_tim10Task = f;
+    cbt_tim8Task = f;
     
-    utils_SaturateU(&period, TE_LOOP_MIN_VALUE, TE_LOOP_MAX_VALUE);
-    TIM10->ARR = (uint16_t) period;
+    cbt_SetCurrentLoopPeriod(period);
 }
 
 /**
-  * @brief  Set the function to call periodically by the timer 6.
+  * @brief  Set the function to call periodically, after the current loop.
   * @param  f: the function to call periodically.
   * @param  period: the period between each call of f [us].
   */
@@ -71,12 +96,11 @@ void cbt_SetHapticControllerTimer(cbt_PeriodicTaskFunc f, uint32_t period)
 {
     cbt_tim6Task = f;
     
-    utils_SaturateU(&period, TE_LOOP_MIN_VALUE, TE_LOOP_MAX_VALUE);
-    TIM6->ARR = (uint16_t) period;
+    cbt_SetHapticControllerPeriod(period);
 }
 
 /**
-  * @brief  Set the function to call periodically by the timer 7.
+  * @brief  Set the function to call periodically, after the haptic controller.
   * @param  f: the function to call periodically.
   * @param  period: the period between each call of f [us].
   */
@@ -84,48 +108,37 @@ void cbt_SetCommLoopTimer(cbt_PeriodicTaskFunc f, uint32_t period)
 {
     cbt_tim7Task = f;
     
-    utils_SaturateU(&period, TE_LOOP_MIN_VALUE, TE_LOOP_MAX_VALUE);
-    TIM7->ARR = (uint16_t) period;
+    cbt_SetCommLoopPeriod(period);
 }
 
 /**
-  * @brief  Initialize TIM10 used for timing the current loop (resolution 1us).
+  * @brief  Enable the update interrupt of TIM8, used for timing the current
+  *         loop. The timer itself is setup by the H-bridge driver.
   */
-void tim10InitFunc(void)
+void tim8InitFunc(void)
 {
-    TIM_TimeBaseInitTypeDef TIM_TimeBaseStruct;
-    //TIM_OCInitTypeDef   TIM_OCInitStruct;
-
     NVIC_InitTypeDef NVIC_InitStruct;
 
-    RCC_APB2PeriphClockCmd(RCC_APB2Periph_TIM10,  ENABLE);
+    RCC_APB2PeriphClockCmd(RCC_APB2Periph_TIM8, ENABLE);
     
-    NVIC_InitStruct.NVIC_IRQChannel                   = TIM1_UP_TIM10_IRQn;
+    NVIC_InitStruct.NVIC_IRQChannel                   = TIM8_UP_TIM13_IRQn;
     NVIC_InitStruct.NVIC_IRQChannelPreemptionPriority = CURRENT_LOOP_IRQ_PRIORITY;
     NVIC_InitStruct.NVIC_IRQChannelSubPriority        = 0;
     NVIC_InitStruct.NVIC_IRQChannelCmd                = ENABLE;
     NVIC_Init(&NVIC_InitStruct);
 
-    TIM_TimeBaseStruct.TIM_Period        = (uint16_t)(TE_CURRENT_LOOP_DEFAULT_VAL-1);    
-    TIM_TimeBaseStruct.TIM_Prescaler     = TIM10_PRESCALER;
-    TIM_TimeBaseStruct.TIM_ClockDivision = 0; // TIM_CKD_DIV2;
-    TIM_TimeBaseStruct.TIM_CounterMode   = TIM_CounterMode_Up;
-    TIM_TimeBaseInit(TIM10, &TIM_TimeBaseStruct);
-
-    TIM_ITConfig(TIM10, TIM_IT_Update, ENABLE);      
-    TIM_Cmd(TIM10, ENABLE);
+    TIM_ITConfig(TIM8, TIM_IT_Update, ENABLE);
 }
 
 /**
-  * @brief  Initialize TIM6, for timing the main control loop (resolution 1us)
-  *         Initialize TIM7, for timing the data transmission loop (resolution 1us)
+  * @brief  Enable the TIM6 and TIM7 interrupts, triggered by software for the
+  *         main control loop and the data transmission loop. The timers
+  *         themselves are not used, since the basic timers can not be slaved
+  *         to the PWM timer.
   */
 void tim67InitFunc(void)
 {
-    TIM_TimeBaseInitTypeDef TIM_TimeBaseStruct;
-    NVIC_InitTypeDef        NVIC_InitStruct;
-
-    RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM6|RCC_APB1Periph_TIM7, ENABLE);
+    NVIC_InitTypeDef NVIC_InitStruct;
 
     NVIC_InitStruct.NVIC_IRQChannel                   = TIM6_DAC_IRQn;
     NVIC_InitStruct.NVIC_IRQChannelPreemptionPriority = CONTROL_LOOP_IRQ_PRIORITY;
@@ -137,71 +150,109 @@ void tim67InitFunc(void)
     NVIC_InitStruct.NVIC_IRQChannelPreemptionPriority = DATA_LOOP_IRQ_PRIORITY;
     NVIC_InitStruct.NVIC_IRQChannelSubPriority        = 0;
     NVIC_Init(&NVIC_InitStruct);    
+}
 
-    TIM_TimeBaseStructInit(&TIM_TimeBaseStruct);
-    TIM_TimeBaseStruct.TIM_Prescaler     = TIM6_PRESCALER;
-    TIM_TimeBaseStruct.TIM_Period        = (uint16_t)(TE_CONTROL_LOOP_DEFAULT_VAL-1);
-    TIM_TimeBaseStruct.TIM_ClockDivision = 0;
-    TIM_TimeBaseStruct.TIM_CounterMode   = TIM_CounterMode_Up;
-    TIM_TimeBaseInit(TIM6, &TIM_TimeBaseStruct);
+/**
+  * @brief  Initialize TIM2, free-running 32-bit counter used as the board clock
+  *         (resolution 1us, overflow every 71 minutes).
+  */
+void tim2InitFunc(void)
+{
+    TIM_TimeBaseInitTypeDef TIM_TimeBaseStruct;
+
+    RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM2, ENABLE);
 
     TIM_TimeBaseStructInit(&TIM_TimeBaseStruct);
-    TIM_TimeBaseStruct.TIM_Prescaler     = TIM7_PRESCALER;
-    TIM_TimeBaseStruct.TIM_Period        = (uint16_t)(TE_DATA_LOOP_DEFAULT_VAL-1);
+    TIM_TimeBaseStruct.TIM_Prescaler     = TIM2_PRESCALER;
+    TIM_TimeBaseStruct.TIM_Period        = 0xFFFFFFFF;
     TIM_TimeBaseStruct.TIM_ClockDivision = 0;
     TIM_TimeBaseStruct.TIM_CounterMode   = TIM_CounterMode_Up;
-    TIM_TimeBaseInit(TIM7, &TIM_TimeBaseStruct);
+    TIM_TimeBaseInit(TIM2, &TIM_TimeBaseStruct);
 
-    TIM_ITConfig(TIM6, TIM_IT_Update, ENABLE);
-    TIM_ITConfig(TIM7, TIM_IT_Update, ENABLE);
-    TIM_Cmd(TIM6, ENABLE);
-    TIM_Cmd(TIM7, ENABLE);
+    TIM_Cmd(TIM2, ENABLE);
 }
 
 /**
-  * @brief  Interrupt from current control loop timer (TIM10)
+  * @brief  Interrupt from current control loop timer (TIM8, PWM)
   */
-void TIM1_UP_TIM10_IRQHandler(void)
+void TIM8_UP_TIM13_IRQHandler(void)
 {
-	if(TIM_GetITStatus(TIM10, TIM_IT_Update) != RESET)
+	if(TIM_GetITStatus(TIM8, TIM_IT_Update) != RESET)
     {
-        if(cbt_tim10Task != NULL)
-            cbt_tim10Task();
+        if(cbt_tim8Task != NULL)
+            cbt_tim8Task();
+
+        // Trigger the haptic controller right after the current loop, at the
+        // selected tick of its period.
+        cbt_currentLoopTicks++;
+        cbt_hapticTick++;
+
+        if(cbt_hapticTick >= cbt_hapticDivider)
+            cbt_hapticTick = 0;
+
+        if(cbt_hapticTick == cbt_hapticPhase)
+            NVIC_SetPendingIRQ(TIM6_DAC_IRQn);
 		
-		TIM_ClearITPendingBit(TIM10, TIM_IT_Update);
+		TIM_ClearITPendingBit(TIM8, TIM_IT_Update);
 	}
 }
 
 /**
-  * @brief  Interrupt from main control loop timer (TIM6)
+  * @brief  Interrupt of the main control loop, triggered by the current loop
   */
 void TIM6_DAC_IRQHandler(void)
 {
-	if(TIM_GetITStatus(TIM6, TIM_IT_Update) != RESET)
+    uint32_t startTime = cbt_GetMicroseconds();
+
+    if(cbt_tim6Task != NULL)
+        cbt_tim6Task();
+
+    // Trigger the data transmission loop right after the main control loop,
+    // when its period has elapsed, so that it does not stream variables being
+    // updated.
+    if((int32_t)(cbt_currentLoopTicks - cbt_nextCommTick) >= 0)
     {
-        if(cbt_tim6Task != NULL)
-            cbt_tim6Task();
-        
-        // Percentage of time consumed by the control task  0..100%.
-		cbt_ucLoad = (((float32_t)(TIM6->CNT))*100)/((float32_t)(TIM6->ARR));
+        cbt_nextCommTick += cbt_commDivider;
 
-		TIM_ClearITPendingBit(TIM6, TIM_IT_Update);
-	}
+        if((int32_t)(cbt_currentLoopTicks - cbt_nextCommTick) >= 0)
+            cbt_nextCommTick = cbt_currentLoopTicks + cbt_commDivider; // Late.
+
+        NVIC_SetPendingIRQ(TIM7_IRQn);
+    }
+
+    // Percentage of time consumed by the control task  0..100%.
+    cbt_ucLoad = ((float32_t)(cbt_GetMicroseconds() - startTime))*100
+                 / ((float32_t)cbt_GetHapticControllerPeriod());
 }
 
 
 /**
-  * @brief  Interrupt from data transmission loop timer (TIM7) (data loop)
+  * @brief  Interrupt of the data transmission loop, triggered by the main
+  *         control loop (data loop)
   */
 void TIM7_IRQHandler(void)
 {
-	if(TIM_GetITStatus(TIM7, TIM_IT_Update) != RESET)
-    {
-		if(cbt_tim7Task != NULL)
-            cbt_tim7Task();
-        
-		TIM_ClearITPendingBit(TIM7, TIM_IT_Update);
-	}
+    if(cbt_tim7Task != NULL)
+        cbt_tim7Task();
+}
+
+/**
+  * @brief  Set the period of the current loop.
+  * @param  period: the new period of the current loop, rounded to a whole
+  *         number of PWM periods [us].
+  */
+void cbt_SetCurrentLoopPeriod(uint32_t period)
+{
+    uint32_t nPwmPeriods = (uint32_t)((float32_t)period / hb_GetPwmPeriod()
+                                      + 0.5f);
+
+    utils_SaturateU(&nPwmPeriods, 1, TE_CURRENT_LOOP_MAX_PWM_PERIODS);
+
+    // The center-aligned counter overflows and underflows once per PWM period.
+    // An even count keeps the update at the bottom of the counter.
+    TIM8->RCR = 2 * nPwmPeriods - 1;
+
+    cbt_UpdateDividers();
 }
 
 /**
@@ -211,7 +262,23 @@ void TIM7_IRQHandler(void)
 void cbt_SetHapticControllerPeriod(uint32_t period)
 {
     utils_SaturateU(&period, TE_LOOP_MIN_VALUE, TE_LOOP_MAX_VALUE);
-    TIM6->ARR = period;
+    cbt_hapticPeriod = period;
+    cbt_UpdateDividers();
+}
+
+/**
+  * @brief  Set the delay between the start of the haptic controller period,
+  *         and the call of the haptic controller.
+  * @param  phase: the new phase of the position loop, rounded to a whole
+  *         number of current loop periods [us].
+  */
+void cbt_SetHapticControllerPhase(uint32_t phase)
+{
+    uint32_t phaseTicks = (uint32_t)((float32_t)phase / cbt_GetCurrentLoopTick()
+                                     + 0.5f);
+
+    utils_SaturateU(&phaseTicks, 0, cbt_hapticDivider - 1);
+    cbt_hapticPhase = phaseTicks;
 }
 
 /**
@@ -221,7 +288,42 @@ void cbt_SetHapticControllerPeriod(uint32_t period)
 void cbt_SetCommLoopPeriod(uint32_t period)
 {
     utils_SaturateU(&period, TE_LOOP_MIN_VALUE, TE_LOOP_MAX_VALUE);
-    TIM7->ARR = period;
+    cbt_commPeriod = period;
+    cbt_UpdateDividers();
+}
+
+/**
+  * @brief  Computes the periods of the haptic controller and communication
+  *         loops in current loop ticks, from the requested periods.
+  */
+void cbt_UpdateDividers(void)
+{
+    float32_t tick = cbt_GetCurrentLoopTick(); // [us].
+    uint32_t hapticDivider = (uint32_t)((float32_t)cbt_hapticPeriod / tick + 0.5f);
+    uint32_t commDivider = (uint32_t)((float32_t)cbt_commPeriod / tick + 0.5f);
+
+    utils_SaturateU(&hapticDivider, 1, TE_LOOP_MAX_VALUE);
+    utils_SaturateU(&commDivider, 1, TE_LOOP_MAX_VALUE);
+
+    if(cbt_hapticPhase >= hapticDivider)
+        cbt_hapticPhase = hapticDivider - 1;
+
+    cbt_hapticDivider = hapticDivider;
+    cbt_commDivider = commDivider;
+}
+
+/**
+  * @brief  Get the exact period of the current loop.
+  * @return the period of the current loop [us].
+  */
+float32_t cbt_GetCurrentLoopTick(void)
+{
+    float32_t tick = (float32_t)(TIM8->RCR + 1) * hb_GetPwmPeriod() / 2.0f;
+
+    if(tick <= 0.0f)
+        return 1.0f; // TIM8 not initialized yet.
+    else
+        return tick;
 }
 
 /**
@@ -230,7 +332,7 @@ void cbt_SetCommLoopPeriod(uint32_t period)
   */
 uint32_t cbt_GetCurrentLoopPeriod(void)
 {
-    return TIM10->ARR;
+    return (uint32_t)(cbt_GetCurrentLoopTick() + 0.5f);
 }
 
 /**
@@ -239,7 +341,19 @@ uint32_t cbt_GetCurrentLoopPeriod(void)
   */
 uint32_t cbt_GetHapticControllerPeriod(void)
 {
-    return TIM6->ARR;
+    return (uint32_t)((float32_t)cbt_hapticDivider * cbt_GetCurrentLoopTick()
+                      + 0.5f);
+}
+
+/**
+  * @brief  Get the delay between the start of the haptic controller period,
+  *         and the call of the haptic controller.
+  * @return the phase of the position loop [us].
+  */
+uint32_t cbt_GetHapticControllerPhase(void)
+{
+    return (uint32_t)((float32_t)cbt_hapticPhase * cbt_GetCurrentLoopTick()
+                      + 0.5f);
 }
 
 /**
@@ -248,5 +362,25 @@ uint32_t cbt_GetHapticControllerPeriod(void)
   */
 uint32_t cbt_GetCommLoopPeriod(void)
 {
-    return TIM7->ARR;
+    return (uint32_t)((float32_t)cbt_commDivider * cbt_GetCurrentLoopTick()
+                      + 0.5f);
+}
+
+/**
+  * @brief  Get the time elapsed since the timers initialization.
+  * @return the board clock value [us]. It overflows every 71 minutes.
+  */
+uint32_t cbt_GetMicroseconds(void)
+{
+    return TIM2->CNT;
+}
+
+/**
+  * @brief  Get the number of core clock cycles elapsed since the timers
+  *         initialization.
+  * @return the cycle counter value [cycles]. It overflows every 25 seconds.
+  */
+uint32_t cbt_GetCycles(void)
+{
+    return DWT->CYCCNT;
 }
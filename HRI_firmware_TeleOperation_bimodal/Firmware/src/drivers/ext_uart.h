@@ -26,20 +26,109 @@
   * This driver controls the UART peripheral of the STM32, connected to the
   * digital extension connector.
   *
-  * Call exuart_Init() first in the initialization code. To send data, call
-  * exuart_SendByteAsync(). To receive data, check first that bytes are
-  * available by calling exuart_ReceivedBytesCount(), then call
-  * exuart_GetByte().
+  * Call exuart_Init() first in the initialization code. Then, send a frame with
+  * exuart_SendFrame(), and get the last frame received from each node with
+  * exuart_GetLastFrame(). Raw bytes can also be sent with
+  * exuart_SendByteAsync(), but the receiver will ignore them.
+  *
+  * The received bytes are parsed in the UART IDLE and RX DMA interrupts,
+  * directly from the DMA buffer. The last valid frame of each node is kept in a
+  * mailbox, so getting it takes a constant time. A frame is made of:
+  *  - the sync word (EXUART_FRAME_SYNC_0, EXUART_FRAME_SYNC_1),
+  *  - the payload length [byte],
+  *  - the address: ID of the node that sent the frame in the 4 LSB, and number
+  *    of times the frame was forwarded in the 4 MSB,
+  *  - the sequence number, incremented by the sender at each frame,
+  *  - the sender timestamp [us] (4 bytes, little-endian),
+  *  - the payload bytes,
+  *  - the CRC-16-CCITT of all the previous bytes except the sync word (2 bytes,
+  *    little-endian).
+  *
+  * Corrupted frames are discarded, and the link quality is counted in a
+  * exuart_LinkStats structure, accessible with exuart_GetLinkStats().
+  *
+  * Up to EXUART_MAX_NODES boards can be connected in a ring: the TX pin of
+  * each board is wired to the RX pin of the next one, so two boards are simply
+  * cross-connected. Each board has a node ID, from 0 to nNodes-1, and forwards
+  * the frames of the other nodes to the next board, until all the nodes
+  * received them. The forwarding is done in the RX interrupt, as soon as the
+  * CRC is checked, so each hop only adds the frame duration. The node ID and
+  * the number of nodes can be changed at runtime with exuart_SetNodeId() and
+  * exuart_SetNodesCount(), that keep them in range.
+  *
+  * In a ring of two nodes, the IDs do not need to be configured: a frame
+  * carrying the local ID can only come from the other board, so it is
+  * published as if it came from node 1 (or 0 if the local ID is 1). In larger
+  * rings, such frames are counted as address errors and discarded.
+  *
+  * Each link carries the frames of nNodes-1 nodes, so the bandwidth available
+  * to each node is the UART bandwidth divided by nNodes-1. At 2 Mbaud (exact
+  * with the 84 MHz APB2 clock), a 350 us tick can carry 70 bytes: 70 bytes per
+  * node with 2 nodes, 35 with 3 nodes, and 23 with 4 nodes (see TeleopLink for
+  * the size of the frames).
   *
   * @addtogroup EXT_UART
   * @{
   */
 
-void exuart_Init(uint32_t baudRate);
+#define EXUART_FRAME_SYNC_0 0xA5 ///< First byte of the frame sync word.
+#define EXUART_FRAME_SYNC_1 0x5A ///< Second byte of the frame sync word.
+#define EXUART_FRAME_HEADER_SIZE 9 ///< Sync word, length, address, sequence number and timestamp [byte].
+#define EXUART_FRAME_CRC_SIZE 2 ///< [byte].
+#define EXUART_FRAME_MAX_PAYLOAD_SIZE 32 ///< [byte].
+#define EXUART_FRAME_MAX_SIZE (EXUART_FRAME_HEADER_SIZE + EXUART_FRAME_MAX_PAYLOAD_SIZE + EXUART_FRAME_CRC_SIZE) ///< [byte].
+#define EXUART_MAX_NODES 4 ///< Max number of boards in the ring, limited by the link budget (the address field allows 16).
+
+/**
+ * @brief Frame exchanged between the boards.
+ */
+typedef struct
+{
+    uint8_t source; ///< ID of the node that sent the frame.
+    uint8_t hops; ///< Number of nodes that forwarded the frame before it was received.
+    uint8_t sequence; ///< Sequence number, incremented by the sender for every frame.
+    uint32_t timestamp; ///< Sender timestamp, when the frame was sent [us].
+    uint32_t rxTime; ///< Local board clock when the frame was received, see cbt_GetMicroseconds() [us].
+    uint8_t length; ///< Number of bytes of the payload.
+    uint8_t payload[EXUART_FRAME_MAX_PAYLOAD_SIZE]; ///< Payload bytes.
+} exuart_Frame;
+
+/**
+ * @brief Link quality counters, updated when the received bytes are parsed.
+ */
+typedef struct
+{
+    uint32_t frames, ///< Number of valid frames received.
+             crcErrors, ///< Number of frames discarded because of a CRC mismatch.
+             gaps, ///< Number of frames missing, according to the sequence numbers.
+             resyncs, ///< Number of times bytes had to be skipped to find a sync word.
+             addressErrors, ///< Number of valid frames discarded because of an invalid source node ID.
+             forwarded; ///< Number of frames forwarded to the next node of the ring.
+} exuart_LinkStats;
+
+/**
+ * @brief Position of the board in the ring.
+ */
+typedef struct
+{
+    uint8_t nodeId; ///< ID of this board, written in the frames sent, lower than nNodes.
+    uint8_t nNodes; ///< Number of boards in the ring, from 2 to EXUART_MAX_NODES.
+} exuart_NodeConfig;
+
+void exuart_Init(uint32_t baudRate, uint8_t nodeId, uint8_t nNodes);
 void exuart_SendByteAsync(uint8_t data);
 void exuart_SendBytesAsync(uint8_t *data, int length);
-uint16_t exuart_ReceivedBytesCount(void);
-uint8_t exuart_GetByte(void);
+
+void exuart_SendFrame(uint32_t timestamp, uint8_t const *payload,
+                      uint8_t length);
+bool exuart_GetLastFrame(uint8_t node, exuart_Frame *frame);
+volatile exuart_LinkStats *exuart_GetLinkStats(void);
+volatile exuart_NodeConfig *exuart_GetNodeConfig(void);
+void exuart_SetNodeId(uint8_t nodeId);
+void exuart_SetNodesCount(uint8_t nNodes);
+uint8_t exuart_GetNodeId(void);
+uint8_t exuart_GetNodesCount(void);
+uint32_t exuart_GetBaudRate(void);
 
 /**
   * @}
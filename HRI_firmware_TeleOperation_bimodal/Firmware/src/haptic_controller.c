@@ -23,78 +23,270 @@
 #include "lib/utils.h"
 #include "torque_regulator.h"
 #include "drivers/ext_uart.h"
+#include "teleop_link.h"
+#include "lib/delay_line.h"
+#include "lib/predictor.h"
+#include "lib/wave_variables.h"
+#include "lib/passivity.h"
+#include "lib/pid.h"
+#include "lib/biquad_filter.h"
+#include "lib/friction_table.h"
+#include "lib/haptic_effects.h"
+#include "lib/disturbance_observer.h"
+#include "lib/state_estimator.h"
 #include "drivers/debug_gpio.h"
 
-#define SYNC_SENDER false
+#define ARCH_POSITION_POSITION 0 // Sends the position, and tracks the position of the coupled nodes with the PID.
+#define ARCH_POSITION_FORCE 1 // Sends the position, and applies the torque of the coupled nodes (master of the torque reflection).
+#define ARCH_FORCE_POSITION 2 // Sends the torque, and tracks the position of the coupled nodes with the PID (slave of the torque reflection).
+#define ARCH_4_CHANNEL 3 // Sends the position, velocity and torque, tracks the position of the coupled nodes and applies their torque.
+#define N_ARCHITECTURES 4
 
-#define DEFAULT_HAPTIC_CONTROLLER_PERIOD 350 // Default control loop period [us].
-#define START_BYTE 0x4D   //starting byte for synchronization
-#define CUT_OFF 50
+// Role of the board, the only settings that differ between the bimodal,
+// master and slave firmwares. All of them can be changed at runtime.
+#define DEFAULT_ARCHITECTURE ARCH_POSITION_POSITION // Bilateral architecture at startup.
+#define DEFAULT_NODE_ID 0 // ID of this board in the ring. In a ring of 2 nodes, both boards can keep the same ID.
+#define DEFAULT_COUPLED_NODES ((1 << DEFAULT_N_NODES) - 1) // Bitmask of the nodes coupled at startup, with a weight of 1: all the nodes of the ring.
+#define SYNC_SENDER false // true to output the DIO sync signal, false to read it.
 
-#define VIRTUAL_WALL false
-#define WALL_ANGLE 15.0
+#define DEFAULT_HAPTIC_CONTROLLER_PERIOD 350 // Default control loop period [us].
 
-#define QUEUE_SIZE 1000*4+1 //1000 samples: Echo effect, very noticeable delay. Stiffness feels increased. Feeling an obstacle through teleoperation also is delayed.  //Number of samples of delay
+#define EXUART_BAUD_RATE 2000000 // Fits the frames of 4 nodes in a 350 us tick [b/s].
+#define DEFAULT_N_NODES 2 // Number of boards in the ring.
+
+#define DELAY_LINE_SIZE 8192 // 2.8 s of delay at the default control loop period [sample].
+#define PREDICTOR_HORIZON 2000.0f // Max extrapolation of the node states, longer than their control loop period [us].
+#define PREDICTOR_FADE_DURATION 50000.0f // Duration of the fade to the safe state, when a link is silent [us].
+
+#define WAVE_OFF 0 // The power variables of the architecture are exchanged.
+#define WAVE_IMPEDANCE_SIDE 1 // Waves are exchanged, this board applies the force decoded from the incoming wave.
+#define WAVE_ADMITTANCE_SIDE 2 // Waves are exchanged, this board tracks the position decoded from the incoming wave with the PID.
+#define DEFAULT_WAVE_IMPEDANCE 0.0001f // Default wave impedance [N.m/(deg/s)].
+#define DEFAULT_WAVE_FILTER_CUTOFF 0.0f // Default cut-off frequency of the incoming wave filter, 0 to disable [Hz].
+
+#define DEFAULT_PASSIVITY_MAX_DAMPING 0.001f // Default max damping injected by the passivity controller [N.m/(deg/s)].
+
+#define DEFAULT_FORCE_GAIN 0.5f // Default gain of the torque of the coupled nodes, in the 4-channel architecture [].
+#define DEFAULT_SWITCH_DURATION 0.2f // Default duration of the torque transition, when the architecture changes [s].
+
+#define DEFAULT_KP 0.001f // Default proportional gain of the coupling PID [N.m/deg].
+#define DEFAULT_KI 0.0f // Default integral gain of the coupling PID [N.m/(deg.s)].
+#define DEFAULT_KD 0.00008f // Default derivative gain of the coupling PID [N.m/(deg/s)].
+#define DEFAULT_KD_CUTOFF 100.0f // Default cut-off frequency of the coupling PID derivative filter [Hz].
+
+#define DEFAULT_ENCODER_FILTER_TYPE BQF_LOW_PASS // Default filter of the paddle angle tracked by the PID.
+#define DEFAULT_ENCODER_FILTER_ORDER 1
+#define DEFAULT_ENCODER_FILTER_CUTOFF 50.0f // [Hz].
+#define DEFAULT_NEIGHBOUR_FILTER_TYPE BQF_NONE // Default filter of the coupled position.
+#define DEFAULT_NEIGHBOUR_FILTER_ORDER 2
+#define DEFAULT_NEIGHBOUR_FILTER_CUTOFF 50.0f // [Hz].
+#define DEFAULT_NOTCH_QUALITY 2.0f // Default quality factor of the filters, when set to notch.
+
+#define DEFAULT_FRICTION_MIN_ANGLE (-30.0f) // Default angle of the first bin of the friction table [deg].
+#define DEFAULT_FRICTION_MAX_ANGLE 30.0f // Default angle of the last bin of the friction table [deg].
+#define DEFAULT_FRICTION_VELOCITY_THRESHOLD 2.0f // Default velocity under which the two directions of the friction table are blended [deg/s].
+#define DEFAULT_FRICTION_SWEEP_VELOCITY 10.0f // Default velocity of the friction calibration sweeps [deg/s].
+#define DEFAULT_FRICTION_N_SWEEPS 3 // Default number of back and forth friction calibration sweeps.
+#define DEFAULT_CALIBRATION_KP 0.005f // Default proportional gain of the friction calibration PID [N.m/deg].
+#define DEFAULT_CALIBRATION_KI 0.05f // Default integral gain of the friction calibration PID [N.m/(deg.s)].
+
+#define DEFAULT_FEEDFORWARD_INERTIA 0.0f // Default paddle inertia compensated by the feedforward [N.m/(deg/s^2)].
+#define DEFAULT_FEEDFORWARD_DAMPING 0.0f // Default paddle viscous damping compensated by the feedforward [N.m/(deg/s)].
+#define DEFAULT_ACCELERATION_FILTER_CUTOFF 20.0f // Default cut-off frequency of the paddle acceleration filter [Hz].
+
+#define DEFAULT_OBSERVER_INERTIA 1.2e-6f // Default nominal inertia of the disturbance observer, rough estimate of the paddle and rotor [N.m/(deg/s^2)].
+#define DEFAULT_OBSERVER_DAMPING 0.0f // Default nominal viscous damping of the disturbance observer [N.m/(deg/s)].
+#define DEFAULT_OBSERVER_CUTOFF 30.0f // Default cut-off frequency of the disturbance observer [Hz].
+
+#define DEFAULT_ESTIMATOR_BANDWIDTH 50.0f // Default bandwidth of the paddle state estimator [Hz].
+#define DEFAULT_HALL_OFFSET 0.0f // Default Hall sensor voltage at the zero paddle angle, to calibrate [V].
+#define DEFAULT_HALL_GAIN 0.0f // Default Hall sensor sensitivity, to calibrate [deg/V].
 
 volatile uint32_t  hapt_timestamp; // Time base of the controller, also used to timestamp the samples sent by streaming [us].
 volatile float32_t hapt_hallVoltage; // Hall sensor output voltage [V].
 volatile float32_t hapt_encoderPaddleAngle; // Paddle angle measured by the incremental encoder [deg].
 volatile float32_t hapt_motorTorque; // Motor torque [N.m].
+volatile float32_t hapt_paddleSpeed; // Paddle velocity, estimated from the timestamps of the encoder edges [deg/s].
+volatile float32_t hapt_paddleAcceleration; // Paddle acceleration, filtered derivative of the velocity [deg/s^2].
 
-volatile float32_t temp = 0.0f;
-volatile bool pid_enable = false;
-volatile bool digital_IO = false;
+volatile uint8_t hapt_architecture = DEFAULT_ARCHITECTURE; // Bilateral architecture, one of the ARCH_ values.
+volatile bool hapt_couplingEnabled = false; // true to apply the coupling torque, false to leave the paddle free.
+volatile float32_t hapt_forceGain = DEFAULT_FORCE_GAIN; // Gain of the torque of the coupled nodes, in the 4-channel architecture [].
+volatile float32_t hapt_switchDuration = DEFAULT_SWITCH_DURATION; // Duration of the torque transition, when the architecture changes [s].
+volatile float32_t hapt_coupledPosition; // Position to track, weighted mean of the coupled nodes positions [deg].
+volatile float32_t hapt_coupledTorque; // Torque to apply, weighted sum of the coupled nodes torques [N.m].
 
-volatile uint8_t slave_bits;	//to check bits received by the slave
-volatile uint32_t bytes_read = 0;
-volatile float32_t temp_float32 = 0.0f;
-volatile float32_t gui_variable = 0.0f;
+volatile uint8_t hapt_txChannels = 0; // Channels of the paddle state sent to the other nodes, in addition to the ones of the architecture, if they fit in the link budget.
+volatile float32_t hapt_couplingWeights[TLINK_MAX_NODES]; // Coupling graph: weight of each node, 0 if not coupled.
+volatile tlink_State hapt_nodeStates[TLINK_MAX_NODES]; // Last paddle state received from each node.
+volatile uint8_t hapt_neighbourNode; // Coupled node with the largest weight, used for the wave variables, the passivity controller and the monitoring.
+volatile tlink_State hapt_neighbourState; // Copy of the state of the neighbour node, for the monitoring.
+volatile tlink_ClockSync hapt_neighbourClockSync; // Copy of the clock estimates of the neighbour node, for the monitoring.
+volatile uint32_t hapt_neighbourTime; // hapt_timestamp converted to the neighbour clock, to align the logs [us].
 
-volatile uint16_t delay_samples = 0;
+volatile float32_t hapt_predictorHorizon = PREDICTOR_HORIZON; // Max extrapolation of the node states [us].
+volatile float32_t hapt_predictorFadeDuration = PREDICTOR_FADE_DURATION; // Duration of the fade to the safe state [us].
+volatile float32_t hapt_predictorWeight; // Weight of the prediction of the neighbour node position, 0 when its link is silent.
 
-//PID gains
-volatile float32_t Kp = 0.001;
-volatile float32_t Ki = 0.000;
-volatile float32_t Kd = 0.00008;
+volatile uint8_t hapt_waveMode = WAVE_OFF; // Wave variables coupling mode, one of WAVE_OFF, WAVE_IMPEDANCE_SIDE or WAVE_ADMITTANCE_SIDE.
+volatile float32_t hapt_outgoingWave; // Wave sent to the neighbour [sqrt(N.m.deg/s)].
+volatile float32_t hapt_waveReference; // Position to track on the admittance side, integrated from the decoded velocity [deg].
 
+volatile bool hapt_passivityEnabled = false; // true to inject damping when the coupling generates energy.
 
-float32_t lowPass(float32_t curr, float32_t prev, float32_t dt);
-float32_t PID(float32_t position_error, float32_t position_error_prev, float32_t dt);
+volatile bool hapt_frictionCompensation = false; // true to add the friction and cogging compensation torque.
+volatile bool hapt_frictionCalibration = false; // Set to true to start the friction calibration, back to false when it is done.
+volatile float32_t hapt_frictionTorque; // Friction and cogging compensation torque [N.m].
+volatile float32_t hapt_frictionSweepVelocity = DEFAULT_FRICTION_SWEEP_VELOCITY; // Velocity of the friction calibration sweeps [deg/s].
+volatile uint8_t hapt_frictionSweeps = DEFAULT_FRICTION_N_SWEEPS; // Number of back and forth friction calibration sweeps.
 
-void hapt_Update(void);
+volatile float32_t hapt_feedforwardInertia = DEFAULT_FEEDFORWARD_INERTIA; // Paddle inertia compensated by the feedforward [N.m/(deg/s^2)].
+volatile float32_t hapt_feedforwardDamping = DEFAULT_FEEDFORWARD_DAMPING; // Paddle viscous damping compensated by the feedforward [N.m/(deg/s)].
+volatile float32_t hapt_feedforwardTorque; // Inertia and damping compensation torque [N.m].
+
+volatile float32_t hapt_effectsTorque; // Torque of the haptic effects [N.m].
+volatile uint32_t hapt_effectsCycles; // Cost of the haptic effects at the last tick [cycles].
+
+volatile float32_t hapt_externalTorque; // External torque applied to the paddle, estimated by the disturbance observer [N.m].
+volatile bool hapt_sendObservedTorque = false; // true to send the observed contact torque to the other nodes, false to send the torque command.
+
+volatile bool hapt_useEstimatedState = false; // true to use the estimated position and acceleration, instead of the filtered encoder angle and velocity derivative.
+
+volatile bool digital_IO = false;
+
+volatile uint32_t delay_us = 0; // Artificial delay applied to the coupled position and torque [us].
+
+uint8_t const hapt_architectureChannels[N_ARCHITECTURES] = // Channels sent by each architecture.
+{
+    TLINK_POSITION, // ARCH_POSITION_POSITION.
+    TLINK_POSITION, // ARCH_POSITION_FORCE.
+    TLINK_TORQUE, // ARCH_FORCE_POSITION.
+    TLINK_POSITION | TLINK_VELOCITY | TLINK_TORQUE // ARCH_4_CHANNEL.
+};
 
 
-uint8_t delayBuffer[QUEUE_SIZE] = { 0 };
-cb_CircularBuffer circDelayBuffer;
+void hapt_Update(void);
+uint8_t hapt_SelectNeighbourNode(uint8_t localNode);
+void hapt_ReadNodeStates(uint8_t localNode);
+
+
+float32_t positionDelayLineBuffer[DELAY_LINE_SIZE];
+float32_t torqueDelayLineBuffer[DELAY_LINE_SIZE];
+dl_DelayLine positionDelayLine;
+dl_DelayLine torqueDelayLine;
+pred_Predictor positionPredictors[TLINK_MAX_NODES];
+pred_Predictor torquePredictors[TLINK_MAX_NODES];
+pred_Predictor wavePredictor;
+wave_Transform waveTransform;
+tdpa_Port couplingPort;
+pid_DiscretePid couplingPid;
+bqf_Filter encoderFilter;
+bqf_Filter neighbourFilter;
+frt_Table frictionTable;
+pid_DiscretePid calibrationPid;
+bqf_Filter accelerationFilter;
+hfx_Engine effectsEngine;
+dob_Observer disturbanceObserver;
+sest_Estimator stateEstimator;
 
 /**
   * @brief Initializes the haptic controller.
   */
 void hapt_Init(void)
 {
-	exuart_Init(576000);
+    volatile exuart_LinkStats *linkStats;
+    volatile tlink_Histograms *linkHistograms;
+    int i;
+
+    exuart_Init(EXUART_BAUD_RATE, DEFAULT_NODE_ID, DEFAULT_N_NODES);
+    tlink_Init();
+    linkStats = exuart_GetLinkStats();
+    linkHistograms = tlink_GetHistograms();
     hapt_timestamp = 0;
     hapt_motorTorque = 0.0f;
-
-    //Initialize delay buffer
-    cb_Init(&circDelayBuffer, delayBuffer, QUEUE_SIZE);
-
-    //Fill buffer with zeros initially
-    for (uint16_t lv = 0; lv<4*delay_samples; lv++){
-    	cb_Push(&circDelayBuffer, 0);
+    hapt_paddleSpeed = 0.0f;
+    hapt_coupledPosition = 0.0f;
+    hapt_coupledTorque = 0.0f;
+    hapt_frictionTorque = 0.0f;
+    hapt_paddleAcceleration = 0.0f;
+    hapt_feedforwardTorque = 0.0f;
+    hapt_effectsTorque = 0.0f;
+    hapt_effectsCycles = 0;
+    hapt_externalTorque = 0.0f;
+
+    //Initialize delay lines, filled with zeros
+    dl_Init(&positionDelayLine, positionDelayLineBuffer, DELAY_LINE_SIZE, 0.0f);
+    dl_Init(&torqueDelayLine, torqueDelayLineBuffer, DELAY_LINE_SIZE, 0.0f);
+
+    //Initialize the coupling graph, and the predictors of the node states
+    for(i=0; i<TLINK_MAX_NODES; i++)
+    {
+        hapt_couplingWeights[i] = (DEFAULT_COUPLED_NODES & (1 << i)) ? 1.0f : 0.0f;
+        pred_Init(&positionPredictors[i], PREDICTOR_HORIZON, PREDICTOR_FADE_DURATION);
+        pred_Init(&torquePredictors[i], PREDICTOR_HORIZON, PREDICTOR_FADE_DURATION);
     }
 
+    pred_Init(&wavePredictor, PREDICTOR_HORIZON, PREDICTOR_FADE_DURATION);
+    hapt_neighbourNode = hapt_SelectNeighbourNode(DEFAULT_NODE_ID);
+
+    //Initialize the wave variables transformation
+    wave_Init(&waveTransform, DEFAULT_WAVE_IMPEDANCE, DEFAULT_WAVE_FILTER_CUTOFF);
+    hapt_outgoingWave = 0.0f;
+    hapt_waveReference = 0.0f;
+
+    //Initialize the passivity observer of the coupling port
+    tdpa_Init(&couplingPort, DEFAULT_PASSIVITY_MAX_DAMPING);
+
+    //Initialize the position coupling PID, saturated to the motor torque
+    pid_InitDiscrete(&couplingPid, DEFAULT_KP, DEFAULT_KI, DEFAULT_KD,
+                     DEFAULT_KD_CUTOFF, -MOTOR_NOMINAL_TORQUE,
+                     MOTOR_NOMINAL_TORQUE);
+
+    //Initialize the filters of the local and coupled positions
+    bqf_Init(&encoderFilter, DEFAULT_ENCODER_FILTER_TYPE,
+             DEFAULT_ENCODER_FILTER_ORDER, DEFAULT_ENCODER_FILTER_CUTOFF,
+             DEFAULT_NOTCH_QUALITY);
+    bqf_Init(&neighbourFilter, DEFAULT_NEIGHBOUR_FILTER_TYPE,
+             DEFAULT_NEIGHBOUR_FILTER_ORDER, DEFAULT_NEIGHBOUR_FILTER_CUTOFF,
+             DEFAULT_NOTCH_QUALITY);
+
+    //Initialize the friction compensation table, and the PID tracking the
+    //calibration sweeps
+    frt_Init(&frictionTable, DEFAULT_FRICTION_MIN_ANGLE,
+             DEFAULT_FRICTION_MAX_ANGLE, DEFAULT_FRICTION_VELOCITY_THRESHOLD);
+    pid_InitDiscrete(&calibrationPid, DEFAULT_CALIBRATION_KP,
+                     DEFAULT_CALIBRATION_KI, 0.0f, DEFAULT_KD_CUTOFF,
+                     -MOTOR_NOMINAL_TORQUE, MOTOR_NOMINAL_TORQUE);
+
+    //Initialize the filter of the paddle acceleration, used by the inertia
+    //compensation
+    bqf_Init(&accelerationFilter, BQF_LOW_PASS, 1,
+             DEFAULT_ACCELERATION_FILTER_CUTOFF, DEFAULT_NOTCH_QUALITY);
+
+    //Initialize the haptic effects engine, without any effect
+    hfx_Init(&effectsEngine);
+
+    //Initialize the disturbance observer, estimating the external torque
+    dob_Init(&disturbanceObserver, DEFAULT_OBSERVER_INERTIA,
+             DEFAULT_OBSERVER_DAMPING, DEFAULT_OBSERVER_CUTOFF);
+
+    //Initialize the paddle state estimator, fusing the encoder and Hall sensor
+    sest_Init(&stateEstimator, DEFAULT_ESTIMATOR_BANDWIDTH, DEFAULT_HALL_OFFSET,
+              DEFAULT_HALL_GAIN);
+
     // Make the timers call the update function periodically.
     cbt_SetHapticControllerTimer(hapt_Update, DEFAULT_HAPTIC_CONTROLLER_PERIOD);
 
     // Share some variables with the computer.
     comm_monitorUint32Func("timestep [us]", cbt_GetHapticControllerPeriod,
                            cbt_SetHapticControllerPeriod);
+    comm_monitorUint32Func("timestep phase [us]", cbt_GetHapticControllerPhase,
+                           cbt_SetHapticControllerPhase);
     comm_monitorFloat("motor_torque [N.m]", (float32_t*)&hapt_motorTorque, READWRITE);
     comm_monitorFloat("encoder_paddle_pos [deg]", (float32_t*)&hapt_encoderPaddleAngle, READONLY);
+    comm_monitorFloat("encoder_paddle_speed [deg/s]", (float32_t*)&hapt_paddleSpeed, READONLY);
     comm_monitorFloat("hall_voltage [V]", (float32_t*)&hapt_hallVoltage, READONLY);
-    comm_monitorBool("enable PID", (bool*) &pid_enable, READWRITE);
-    comm_monitorUint16("delay [samples]", (uint32_t*) &delay_samples, READWRITE);
+    comm_monitorUint32("delay [us]", (uint32_t*) &delay_us, READWRITE);
 
 #if SYNC_SENDER
     comm_monitorBool("enable DIO", (bool*) &digital_IO, READWRITE);
@@ -102,73 +294,195 @@ void hapt_Init(void)
     comm_monitorBool("enable DIO", (bool*) &digital_IO, READONLY);
 #endif
 
-
-    comm_monitorFloat("Neighbour position [deg]", (float32_t*)&gui_variable, READONLY);
+    //---------------Architecture---------------
+    comm_monitorUint8("architecture", (uint8_t*)&hapt_architecture, READWRITE);
+    comm_monitorBool("enable coupling", (bool*)&hapt_couplingEnabled, READWRITE);
+    comm_monitorFloat("4-channel force gain", (float32_t*)&hapt_forceGain, READWRITE);
+    comm_monitorFloat("switch duration [s]", (float32_t*)&hapt_switchDuration, READWRITE);
+    comm_monitorFloat("coupled position [deg]", (float32_t*)&hapt_coupledPosition, READONLY);
+    comm_monitorFloat("coupled torque [N.m]", (float32_t*)&hapt_coupledTorque, READONLY);
+    //------------------------------------------
     //--------------PID controller--------------
-    comm_monitorFloat("Kp", (float32_t*)&Kp, READWRITE);
-    comm_monitorFloat("Ki", (float32_t*)&Ki, READWRITE);
-    comm_monitorFloat("Kd", (float32_t*)&Kd, READWRITE);
+    comm_monitorFloat("Kp", &couplingPid.kp, READWRITE);
+    comm_monitorFloat("Ki", &couplingPid.ki, READWRITE);
+    comm_monitorFloat("Kd", &couplingPid.kd, READWRITE);
+    comm_monitorFloat("Kd cutoff [Hz]", &couplingPid.derivativeCutoff, READWRITE);
+    comm_monitorFloat("Kd target weight", &couplingPid.derivativeTargetWeight, READWRITE);
+    //------------------------------------------
+    //-----------------Filters------------------
+    comm_monitorUint8("encoder filter type", &encoderFilter.type, READWRITE);
+    comm_monitorUint8("encoder filter order", &encoderFilter.order, READWRITE);
+    comm_monitorFloat("encoder filter cutoff [Hz]", &encoderFilter.cutoff, READWRITE);
+    comm_monitorFloat("encoder filter Q", &encoderFilter.quality, READWRITE);
+    comm_monitorUint8("neighbour filter type", &neighbourFilter.type, READWRITE);
+    comm_monitorUint8("neighbour filter order", &neighbourFilter.order, READWRITE);
+    comm_monitorFloat("neighbour filter cutoff [Hz]", &neighbourFilter.cutoff, READWRITE);
+    comm_monitorFloat("neighbour filter Q", &neighbourFilter.quality, READWRITE);
+    //------------------------------------------
+    //--------------Link statistics-------------
+    comm_monitorUint32("link frames", (uint32_t*)&linkStats->frames, READONLY);
+    comm_monitorUint32("link CRC errors", (uint32_t*)&linkStats->crcErrors, READONLY);
+    comm_monitorUint32("link gaps [frames]", (uint32_t*)&linkStats->gaps, READONLY);
+    comm_monitorUint32("link resyncs", (uint32_t*)&linkStats->resyncs, READONLY);
+    comm_monitorUint32("link address errors", (uint32_t*)&linkStats->addressErrors, READONLY);
+    comm_monitorUint32("link forwarded frames", (uint32_t*)&linkStats->forwarded, READONLY);
+    comm_monitorUint32Func("link budget overflows", tlink_GetBudgetOverflows, NULL);
+    comm_monitorUint8("link TX extra channels", (uint8_t*)&hapt_txChannels, READWRITE);
+    comm_monitorUint8("link RX channels", (uint8_t*)&hapt_neighbourState.channels, READONLY);
+    comm_monitorFloat("neighbour position [deg]", (float32_t*)&hapt_neighbourState.position, READONLY);
+    comm_monitorFloat("neighbour velocity [deg/s]", (float32_t*)&hapt_neighbourState.velocity, READONLY);
+    comm_monitorFloat("neighbour torque [N.m]", (float32_t*)&hapt_neighbourState.torque, READONLY);
+    comm_monitorFloat("neighbour current [A]", (float32_t*)&hapt_neighbourState.current, READONLY);
+    //------------------------------------------
+    //----------------Node network--------------
+    comm_monitorUint8Func("node ID", exuart_GetNodeId, exuart_SetNodeId);
+    comm_monitorUint8Func("number of nodes", exuart_GetNodesCount,
+                          exuart_SetNodesCount);
+    comm_monitorVar("coupling weights", (void*)hapt_couplingWeights, FLOAT32,
+                    sizeof(hapt_couplingWeights), READWRITE);
+    comm_monitorUint8("neighbour node", (uint8_t*)&hapt_neighbourNode, READONLY);
+    //------------------------------------------
+    //-----------Neighbour predictor------------
+    comm_monitorFloat("predictor horizon [us]", (float32_t*)&hapt_predictorHorizon, READWRITE);
+    comm_monitorFloat("predictor fade time [us]", (float32_t*)&hapt_predictorFadeDuration, READWRITE);
+    comm_monitorFloat("predictor weight", (float32_t*)&hapt_predictorWeight, READONLY);
+    //------------------------------------------
+    //--------------Wave variables--------------
+    comm_monitorUint8("wave mode", (uint8_t*)&hapt_waveMode, READWRITE);
+    comm_monitorFloat("wave impedance [N.m/(deg/s)]", &waveTransform.impedance, READWRITE);
+    comm_monitorFloat("wave filter cutoff [Hz]", &waveTransform.filter.cutoff, READWRITE);
+    comm_monitorFloat("outgoing wave", (float32_t*)&hapt_outgoingWave, READONLY);
+    comm_monitorFloat("wave reference [deg]", (float32_t*)&hapt_waveReference, READONLY);
+    //------------------------------------------
+    //------------Passivity controller----------
+    comm_monitorBool("enable passivity control", (bool*)&hapt_passivityEnabled, READWRITE);
+    comm_monitorFloat("passivity max damping [N.m/(deg/s)]", &couplingPort.maxDamping, READWRITE);
+    comm_monitorDouble("coupling input energy [N.m.deg]", &couplingPort.inputEnergy, READONLY);
+    comm_monitorDouble("coupling output energy [N.m.deg]", &couplingPort.outputEnergy, READONLY);
+    comm_monitorDouble("neighbour input energy [N.m.deg]", &couplingPort.remoteInputEnergy, READONLY);
+    comm_monitorDouble("observed energy [N.m.deg]", &couplingPort.observedEnergy, READONLY);
+    comm_monitorFloat("injected damping [N.m/(deg/s)]", &couplingPort.damping, READONLY);
+    //------------------------------------------
+    //----------Friction compensation-----------
+    comm_monitorBool("enable friction compensation", (bool*)&hapt_frictionCompensation, READWRITE);
+    comm_monitorFloat("friction torque [N.m]", (float32_t*)&hapt_frictionTorque, READONLY);
+    comm_monitorFloat("friction gain", &frictionTable.gain, READWRITE);
+    comm_monitorFloat("friction velocity threshold [deg/s]", &frictionTable.velocityThreshold, READWRITE);
+    comm_monitorFloat("friction min angle [deg]", &frictionTable.minAngle, READWRITE);
+    comm_monitorFloat("friction max angle [deg]", &frictionTable.maxAngle, READWRITE);
+    comm_monitorVar("friction table + [N.m]", (void*)frictionTable.positiveTorques,
+                    FLOAT32, sizeof(frictionTable.positiveTorques), READWRITE);
+    comm_monitorVar("friction table - [N.m]", (void*)frictionTable.negativeTorques,
+                    FLOAT32, sizeof(frictionTable.negativeTorques), READWRITE);
+    comm_monitorBool("friction calibration", (bool*)&hapt_frictionCalibration, READWRITE);
+    comm_monitorFloat("friction sweep velocity [deg/s]", (float32_t*)&hapt_frictionSweepVelocity, READWRITE);
+    comm_monitorUint8("friction sweeps", (uint8_t*)&hapt_frictionSweeps, READWRITE);
+    comm_monitorFloat("friction calibration Kp", &calibrationPid.kp, READWRITE);
+    comm_monitorFloat("friction calibration Ki", &calibrationPid.ki, READWRITE);
+    //------------------------------------------
+    //------------Model feedforward-------------
+    comm_monitorFloat("feedforward inertia [N.m/(deg/s^2)]", (float32_t*)&hapt_feedforwardInertia, READWRITE);
+    comm_monitorFloat("feedforward damping [N.m/(deg/s)]", (float32_t*)&hapt_feedforwardDamping, READWRITE);
+    comm_monitorFloat("feedforward torque [N.m]", (float32_t*)&hapt_feedforwardTorque, READONLY);
+    comm_monitorFloat("paddle acceleration [deg/s^2]", (float32_t*)&hapt_paddleAcceleration, READONLY);
+    comm_monitorUint8("acceleration filter order", &accelerationFilter.order, READWRITE);
+    comm_monitorFloat("acceleration filter cutoff [Hz]", &accelerationFilter.cutoff, READWRITE);
+    //------------------------------------------
+    //--------------Haptic effects--------------
+    comm_monitorVar("effect types", (void*)effectsEngine.types, UINT8,
+                    sizeof(effectsEngine.types), READWRITE);
+    comm_monitorVar("effect positions [deg]", (void*)effectsEngine.positions, FLOAT32,
+                    sizeof(effectsEngine.positions), READWRITE);
+    comm_monitorVar("effect stiffnesses [N.m/deg]", (void*)effectsEngine.stiffnesses, FLOAT32,
+                    sizeof(effectsEngine.stiffnesses), READWRITE);
+    comm_monitorVar("effect dampings [N.m/(deg/s)]", (void*)effectsEngine.dampings, FLOAT32,
+                    sizeof(effectsEngine.dampings), READWRITE);
+    comm_monitorVar("effect widths [deg]", (void*)effectsEngine.widths, FLOAT32,
+                    sizeof(effectsEngine.widths), READWRITE);
+    comm_monitorVar("effect max torques [N.m]", (void*)effectsEngine.maxTorques, FLOAT32,
+                    sizeof(effectsEngine.maxTorques), READWRITE);
+    comm_monitorVar("effect table [N.m]", (void*)effectsEngine.table, FLOAT32,
+                    sizeof(effectsEngine.table), READWRITE);
+    comm_monitorUint8("active effects", &effectsEngine.nActiveEffects, READONLY);
+    comm_monitorFloat("effects torque [N.m]", (float32_t*)&hapt_effectsTorque, READONLY);
+    comm_monitorUint32("effects cost [cycles]", (uint32_t*)&hapt_effectsCycles, READONLY);
+    //------------------------------------------
+    //-----------Disturbance observer-----------
+    comm_monitorFloat("external torque [N.m]", (float32_t*)&hapt_externalTorque, READONLY);
+    comm_monitorBool("send observed torque", (bool*)&hapt_sendObservedTorque, READWRITE);
+    comm_monitorFloat("observer inertia [N.m/(deg/s^2)]", &disturbanceObserver.inertia, READWRITE);
+    comm_monitorFloat("observer damping [N.m/(deg/s)]", &disturbanceObserver.damping, READWRITE);
+    comm_monitorFloat("observer cutoff [Hz]", &disturbanceObserver.cutoff, READWRITE);
+    //------------------------------------------
+    //-------------State estimator--------------
+    comm_monitorBool("use estimated state", (bool*)&hapt_useEstimatedState, READWRITE);
+    comm_monitorFloat("estimated position [deg]", &stateEstimator.position, READONLY);
+    comm_monitorFloat("estimated velocity [deg/s]", &stateEstimator.velocity, READONLY);
+    comm_monitorFloat("estimated acceleration [deg/s^2]", &stateEstimator.acceleration, READONLY);
+    comm_monitorFloat("encoder residual [deg]", &stateEstimator.encoderResidual, READONLY);
+    comm_monitorFloat("hall residual [deg]", &stateEstimator.hallResidual, READONLY);
+    comm_monitorBool("encoder slip", &stateEstimator.slipDetected, READWRITE);
+    comm_monitorFloat("estimator bandwidth [Hz]", &stateEstimator.bandwidth, READWRITE);
+    comm_monitorFloat("hall offset [V]", &stateEstimator.hallOffset, READWRITE);
+    comm_monitorFloat("hall gain [deg/V]", &stateEstimator.hallGain, READWRITE);
+    comm_monitorFloat("hall correction cutoff [Hz]", &stateEstimator.hallCorrectionCutoff, READWRITE);
+    comm_monitorFloat("slip threshold [deg]", &stateEstimator.slipThreshold, READWRITE);
+    //------------------------------------------
+    //-----------Clock synchronization----------
+    comm_monitorInt32("clock offset [us]", (int32_t*)&hapt_neighbourClockSync.offset, READONLY);
+    comm_monitorUint32("round-trip time [us]", (uint32_t*)&hapt_neighbourClockSync.roundTripTime, READONLY);
+    comm_monitorUint32("one-way delay [us]", (uint32_t*)&hapt_neighbourClockSync.oneWayDelay, READONLY);
+    comm_monitorFloat("clock drift [ppm]", (float32_t*)&hapt_neighbourClockSync.drift, READONLY);
+    comm_monitorUint32("neighbour time [us]", (uint32_t*)&hapt_neighbourTime, READONLY);
+    comm_monitorVar("link histograms [us]", (void*)linkHistograms, UINT32,
+                    sizeof(tlink_Histograms), READONLY);
     //------------------------------------------
 }
 
 /**
   * @brief Updates the haptic controller state.
+  * The coupling torque is computed with the selected architecture. When the
+  * architecture or the wave mode changes, the difference between the previous
+  * torque and the new one fades out linearly over hapt_switchDuration, so the
+  * switch is bumpless.
   */
 void hapt_Update()
 {
+    tlink_State localState;
+    static uint8_t architecture_prev = DEFAULT_ARCHITECTURE;
+    static uint8_t waveMode_prev = WAVE_OFF;
+    static bool calibrating_prev = false;
+    static float32_t paddleSpeed_prev = 0.0f;
+    static float32_t switchTorqueOffset = 0.0f;
+    static float32_t switchElapsedTime = 0.0f;
+    uint8_t localNode = exuart_GetNodeConfig()->nodeId;
+    uint8_t architecture = hapt_architecture;
+    uint8_t txChannels, extraChannel;
+    float32_t filteredPaddleAngle, positionToTrack, pidTorque;
+    float32_t torqueLimit = torq_GetTorqueLimit(); // [N.m].
+    float32_t waveForce = 0.0f;
+    float32_t couplingTorque;
+    float32_t weightSum = 0.0f;
+    int i;
 
-	static uint32_t temp_int32 = 0;
-	void *temp_point = NULL;
-	void *temp_pointer = &temp;
-	//uint32_t temp_word = *(uint32_t *)temp_pointer;
-	static uint32_t second_div = 0;
-	static float32_t temp_float32_prev = 0.0f;
-	static float32_t position_error_prev = 0.0f;
-	static float32_t hapt_encoderPaddleAngle_prev = 0.0f;
-	float32_t temp_float32 = 0.0f;
+    float32_t motorShaftAngle; // [deg].
+
+    // Compute the dt.
+    float32_t dt = ((float32_t)cbt_GetHapticControllerPeriod()) / 1000000.0f; // [s].
+    float32_t period = (float32_t)cbt_GetHapticControllerPeriod(); // [us].
 
 #if SYNC_SENDER
-	//Set/reset GPIO
-	dio_Set(0, digital_IO);
+    //Set/reset GPIO
+    dio_Set(0, digital_IO);
 #else
-	digital_IO = dio_Get(1);
+    digital_IO = dio_Get(1);
 #endif
 
-	if (cb_ItemsCount(&circDelayBuffer) > 4*delay_samples)
-	{
-	    //Discharge buffer
-	    while (cb_ItemsCount(&circDelayBuffer) > 4*delay_samples)
-	    {
-	    	cb_Pull(&circDelayBuffer);
-	    	cb_Pull(&circDelayBuffer);
-	    	cb_Pull(&circDelayBuffer);
-	    	cb_Pull(&circDelayBuffer);
-	    }
-	}
-	else if (cb_ItemsCount(&circDelayBuffer) < 4*delay_samples)
-	{
-		uint8_t bytes[4];
-		bytes[0] = temp_int32 && 0xFF;
-		bytes[1] = temp_int32>>8 && 0xFF;
-		bytes[2] = temp_int32>>16 && 0xFF;
-		bytes[3] = temp_int32>>24 && 0xFF;;
-
-	    while (cb_ItemsCount(&circDelayBuffer) < 4*delay_samples)
-	    {
-	    	cb_Push(&circDelayBuffer, bytes[0]);
-	    	cb_Push(&circDelayBuffer, bytes[1]);
-	    	cb_Push(&circDelayBuffer, bytes[2]);
-	    	cb_Push(&circDelayBuffer, bytes[3]);
-	    }
-	}
-
-    float32_t motorShaftAngle; // [deg].
-
-    // Compute the dt (uncomment if you need it).
-    float32_t dt = ((float32_t)cbt_GetHapticControllerPeriod()) / 1000000.0f; // [s].
+    if(architecture >= N_ARCHITECTURES)
+        architecture = architecture_prev; // Invalid value, keep the current architecture.
 
-    // Increment the timestamp.
-    hapt_timestamp += cbt_GetHapticControllerPeriod();
+    // Get the timestamp from the board clock.
+    hapt_timestamp = cbt_GetMicroseconds();
     
     // Get the Hall sensor voltage.
     hapt_hallVoltage = hall_GetVoltage();
@@ -177,117 +491,389 @@ void hapt_Update()
     motorShaftAngle = enc_GetPosition();
     hapt_encoderPaddleAngle = motorShaftAngle / REDUCTION_RATIO;
 
+    // Get the paddle speed, and estimate the acceleration.
+    hapt_paddleSpeed = enc_GetVelocity() / REDUCTION_RATIO;
+    hapt_paddleAcceleration = bqf_Step(&accelerationFilter,
+                                       (hapt_paddleSpeed - paddleSpeed_prev) / dt,
+                                       dt);
+    paddleSpeed_prev = hapt_paddleSpeed;
+
+    // Estimate the external torque applied to the paddle (operator or
+    // contact), from the motor torque measured by the current loop. The
+    // friction of the table is part of the model.
+    hapt_externalTorque = dob_Step(&disturbanceObserver, torq_GetTorque(),
+                                   hapt_paddleSpeed,
+                                   frt_GetTorque(&frictionTable,
+                                                 hapt_encoderPaddleAngle,
+                                                 hapt_paddleSpeed),
+                                   dt);
+
+    // Filter the position used by the PID.
+    filteredPaddleAngle = bqf_Step(&encoderFilter, hapt_encoderPaddleAngle, dt);
+
+    // Estimate the paddle state from the encoder and the Hall sensor. It can
+    // replace the filtered angle and the velocity derivative.
+    sest_Step(&stateEstimator, hapt_encoderPaddleAngle, hapt_hallVoltage, dt);
+
+    if(hapt_useEstimatedState)
+    {
+        filteredPaddleAngle = stateEstimator.position;
+        hapt_paddleAcceleration = stateEstimator.acceleration;
+    }
+
+    // reading the last state received from each node
+    hapt_ReadNodeStates(localNode);
+
+    // extrapolating the position and torque of each node between the frames,
+    // fading to the local position and to zero torque (no coupling force) if
+    // its link is silent. The coupled position is the weighted mean of the
+    // coupled nodes positions, and the coupled torque the weighted sum of their
+    // torques. Both are computed in all the architectures, so the switch is
+    // immediate. In wave mode, the delayed signal is the incoming wave of the
+    // neighbour, that fades to zero instead.
+    hapt_coupledPosition = 0.0f;
+    hapt_coupledTorque = 0.0f;
+
+    for(i=0; i<TLINK_MAX_NODES; i++)
+    {
+        float32_t position, torque;
+
+        positionPredictors[i].horizon = hapt_predictorHorizon;
+        positionPredictors[i].fadeDuration = hapt_predictorFadeDuration;
+        torquePredictors[i].horizon = hapt_predictorHorizon;
+        torquePredictors[i].fadeDuration = hapt_predictorFadeDuration;
+
+        position = pred_Step(&positionPredictors[i], hapt_encoderPaddleAngle, period);
+        torque = pred_Step(&torquePredictors[i], 0.0f, period);
 
-    // sending bits to slave
-    second_div++;
+        if(i == localNode || hapt_couplingWeights[i] <= 0.0f)
+            continue;
 
-    if(second_div % 1 == 0){
-    	uint8_t* byte_pointer = &hapt_encoderPaddleAngle;
-    	exuart_SendByteAsync(START_BYTE);
-    	exuart_SendByteAsync(*(byte_pointer)++); //sending
-    	exuart_SendByteAsync(*(byte_pointer)++); //sending
-    	exuart_SendByteAsync(*(byte_pointer)++); //sending
-    	exuart_SendByteAsync(*(byte_pointer)++); //sending
+        hapt_coupledTorque += hapt_couplingWeights[i] * torque;
+
+        // a node never heard from would pull the mean towards the local angle
+        if(positionPredictors[i].hasSample)
+        {
+            hapt_coupledPosition += hapt_couplingWeights[i] * position;
+            weightSum += hapt_couplingWeights[i];
+        }
     }
 
-    //discard bytes until we have 9 bytes
-    while(exuart_ReceivedBytesCount() >= 9){
-    	exuart_GetByte();
+    if(weightSum > 0.0f)
+        hapt_coupledPosition /= weightSum;
+    else
+        hapt_coupledPosition = hapt_encoderPaddleAngle; // not coupled
+
+    hapt_coupledPosition = bqf_Step(&neighbourFilter, hapt_coupledPosition, dt);
+
+    wavePredictor.horizon = hapt_predictorHorizon;
+    wavePredictor.fadeDuration = hapt_predictorFadeDuration;
+    hapt_predictorWeight = positionPredictors[hapt_neighbourNode].weight;
+
+    if(hapt_waveMode != WAVE_OFF)
+    {
+        positionToTrack = pred_Step(&wavePredictor, 0.0f, period);
+        positionToTrack = dl_Step(&positionDelayLine, positionToTrack,
+                                  (float32_t)delay_us, period);
     }
-    // reading position values from neighbour
-    if(exuart_ReceivedBytesCount() >= 5){
-    	//should keep reading the bytes until you see header
-	   while(exuart_ReceivedBytesCount() >= 5){ //if any bits received
-			slave_bits = exuart_GetByte();
-			if(slave_bits == START_BYTE){ //check the header byte
-				//if number of bytes received is >= 4 bytes, then keep receiving
-			    //Implement delay
-			    cb_Push(&circDelayBuffer, exuart_GetByte());
-			    cb_Push(&circDelayBuffer, exuart_GetByte());
-			    cb_Push(&circDelayBuffer, exuart_GetByte());
-			    cb_Push(&circDelayBuffer, exuart_GetByte());
-
-				slave_bits = cb_Pull(&circDelayBuffer);
-				temp_int32 = slave_bits;
-
-				slave_bits = cb_Pull(&circDelayBuffer);
-				temp_int32 |= slave_bits << 8;
-
-				slave_bits = cb_Pull(&circDelayBuffer);
-				temp_int32 |= slave_bits << 16;
-
-				slave_bits = cb_Pull(&circDelayBuffer);
-				temp_int32 |= slave_bits << 24;
-
-				temp_point = &temp_int32;
-				temp_float32 = *(float32_t *) temp_point;
-				bytes_read = temp_int32;
-
-				gui_variable = temp_float32;
-				break;
-			}
-	   }
-	}
-
-	// filtering the positions of each neighbour
-	//temp_float32 = lowPass(temp_float32, temp_float32_prev, dt);
-	hapt_encoderPaddleAngle = lowPass(hapt_encoderPaddleAngle, hapt_encoderPaddleAngle_prev, dt);
-
-	float32_t position_error = 0.0;
-
-	// PID between neighbours
-    if(pid_enable){
-#if VIRTUAL_WALL
-    	if (temp_float32 > WALL_ANGLE)
-    	{
-    		position_error = WALL_ANGLE - hapt_encoderPaddleAngle;
-    	}
-    	else if (temp_float32 < -WALL_ANGLE)
-    	{
-    		position_error = -WALL_ANGLE - hapt_encoderPaddleAngle;
-    	}
-    	else
-    	{
-    		// pos error of current device and its neighbour
-    		position_error = temp_float32 - hapt_encoderPaddleAngle;
-    	}
-#else
-		// pos error of current device and its neighbour
-		position_error = temp_float32 - hapt_encoderPaddleAngle;
-#endif
-		hapt_motorTorque = PID(position_error, position_error_prev, dt);
+    else
+    {
+        positionToTrack = dl_Step(&positionDelayLine, hapt_coupledPosition,
+                                  (float32_t)delay_us, period);
+    }
+
+    hapt_coupledTorque = dl_Step(&torqueDelayLine, hapt_coupledTorque,
+                                 (float32_t)delay_us, period);
+
+    // restart the wave coupling from the current position, when the mode changes
+    if(hapt_waveMode != waveMode_prev)
+    {
+        hapt_waveReference = filteredPaddleAngle;
+        hapt_outgoingWave = 0.0f;
+        wave_Reset(&waveTransform);
+    }
+
+    // decoding the incoming wave into the force to apply (impedance side), or
+    // into the position to track with the PID (admittance side)
+    if(hapt_waveMode == WAVE_IMPEDANCE_SIDE)
+    {
+        positionToTrack = wave_Filter(&waveTransform, positionToTrack, dt);
+        hapt_outgoingWave = wave_ImpedanceStep(&waveTransform, hapt_paddleSpeed,
+                                               positionToTrack, &waveForce);
+        positionToTrack = filteredPaddleAngle; // no position coupling
+    }
+    else if(hapt_waveMode == WAVE_ADMITTANCE_SIDE)
+    {
+        float32_t waveVelocity;
+
+        positionToTrack = wave_Filter(&waveTransform, positionToTrack, dt);
+        hapt_outgoingWave = wave_AdmittanceStep(&waveTransform, hapt_motorTorque,
+                                                positionToTrack, &waveVelocity);
+
+        if(hapt_couplingEnabled)
+            hapt_waveReference += waveVelocity * dt;
+        else
+            hapt_waveReference = filteredPaddleAngle;
+
+        positionToTrack = hapt_waveReference;
+    }
+
+    // track the position of the coupled nodes. The PID is stepped in all the
+    // architectures, so its state is up to date when it is switched to. Its
+    // command is limited to the torque allowed by the thermal model.
+    couplingPid.commandMin = -torqueLimit;
+    couplingPid.commandMax = torqueLimit;
+    pidTorque = pid_StepDiscrete(&couplingPid, filteredPaddleAngle,
+                                 positionToTrack, dt);
+
+    // compute the coupling torque of the selected architecture. The force
+    // reflected by the coupled nodes opposes the motion.
+    if(hapt_waveMode == WAVE_IMPEDANCE_SIDE)
+        couplingTorque = -waveForce;
+    else if(hapt_waveMode == WAVE_ADMITTANCE_SIDE)
+        couplingTorque = pidTorque;
+    else
+    {
+        switch(architecture)
+        {
+        case ARCH_POSITION_FORCE:
+            couplingTorque = -hapt_coupledTorque;
+            break;
+
+        case ARCH_4_CHANNEL:
+            couplingTorque = pidTorque - hapt_forceGain * hapt_coupledTorque;
+            break;
+
+        case ARCH_POSITION_POSITION:
+        case ARCH_FORCE_POSITION:
+        default:
+            couplingTorque = pidTorque;
+            break;
+        }
+    }
+
+    // start or abort the friction calibration, when requested by the computer
+    if(hapt_frictionCalibration && !frictionTable.calibrating)
+    {
+        frt_StartCalibration(&frictionTable, hapt_encoderPaddleAngle,
+                             hapt_frictionSweepVelocity, hapt_frictionSweeps);
+        pid_ResetDiscrete(&calibrationPid, hapt_encoderPaddleAngle,
+                          hapt_encoderPaddleAngle);
+        hapt_frictionCalibration = frictionTable.calibrating;
+    }
+    else if(!hapt_frictionCalibration && frictionTable.calibrating)
+        frt_AbortCalibration(&frictionTable);
+
+    // bumpless switch: keep the torque continuous, and fade the difference out
+    if(architecture != architecture_prev || hapt_waveMode != waveMode_prev ||
+       frictionTable.calibrating != calibrating_prev)
+    {
+        switchTorqueOffset = hapt_motorTorque - couplingTorque;
+        switchElapsedTime = 0.0f;
+        architecture_prev = architecture;
+        waveMode_prev = hapt_waveMode;
+        calibrating_prev = frictionTable.calibrating;
+    }
+
+    if(switchElapsedTime < hapt_switchDuration)
+    {
+        couplingTorque += switchTorqueOffset
+                          * (1.0f - switchElapsedTime / hapt_switchDuration);
+        switchElapsedTime += dt;
+    }
+
+    // friction calibration: the paddle tracks a reference sweeping the angle
+    // range at constant velocity, and the torque needed is recorded, instead
+    // of applying the coupling torque
+    if(frictionTable.calibrating)
+    {
+        float32_t sweepReference;
+
+        sweepReference = frt_StepCalibration(&frictionTable,
+                                             hapt_encoderPaddleAngle,
+                                             hapt_paddleSpeed,
+                                             hapt_motorTorque, dt);
+        hapt_motorTorque = pid_StepDiscrete(&calibrationPid,
+                                            hapt_encoderPaddleAngle,
+                                            sweepReference, dt);
+        hapt_frictionCalibration = frictionTable.calibrating;
+    }
+    else if(hapt_couplingEnabled)
+        hapt_motorTorque = couplingTorque;
+    else
+        hapt_motorTorque = 0.0f;
+
+    // the PID does not accumulate an error while its torque is not applied
+    if(!hapt_couplingEnabled || frictionTable.calibrating ||
+       hapt_waveMode == WAVE_IMPEDANCE_SIDE ||
+       (hapt_waveMode == WAVE_OFF && architecture == ARCH_POSITION_FORCE))
+    {
+        pid_ResetDiscrete(&couplingPid, filteredPaddleAngle, positionToTrack);
+    }
+
+    // saturation block, to the torque allowed by the thermal model
+    utils_SaturateF((float32_t*)&hapt_motorTorque, -torqueLimit, torqueLimit);
+
+    // passivity controller, dissipating the energy generated by the coupling
+    // (e.g. because of the delay). The damping is saturated as well.
+    if(hapt_passivityEnabled && hapt_couplingEnabled &&
+       !frictionTable.calibrating)
+    {
+        hapt_motorTorque = tdpa_Step(&couplingPort, hapt_motorTorque,
+                                     hapt_paddleSpeed, dt);
+        utils_SaturateF((float32_t*)&hapt_motorTorque, -torqueLimit,
+                        torqueLimit);
+    }
+
+    // friction and cogging compensation, feedforward from the calibrated table.
+    // It is not part of the coupling torque sent to the other nodes.
+    if(hapt_frictionCompensation && !frictionTable.calibrating)
+    {
+        hapt_frictionTorque = frt_GetTorque(&frictionTable,
+                                            hapt_encoderPaddleAngle,
+                                            hapt_paddleSpeed);
+    }
+    else
+        hapt_frictionTorque = 0.0f;
+
+    // inertia and viscous damping compensation, feedforward from the paddle
+    // model, so the operator does not feel them
+    if(!frictionTable.calibrating)
+    {
+        hapt_feedforwardTorque = hapt_feedforwardInertia * hapt_paddleAcceleration
+                                 + hapt_feedforwardDamping * hapt_paddleSpeed;
     }
     else
+        hapt_feedforwardTorque = 0.0f;
+
+    // haptic effects of the virtual environment (walls, springs...). They are
+    // not rendered during the friction calibration.
+    if(!frictionTable.calibrating)
+    {
+        uint32_t startCycles = cbt_GetCycles();
+
+        hapt_effectsTorque = hfx_Step(&effectsEngine, hapt_encoderPaddleAngle,
+                                      hapt_paddleSpeed);
+        hapt_effectsCycles = cbt_GetCycles() - startCycles;
+    }
+    else
+        hapt_effectsTorque = 0.0f;
+
+    torq_SetTorque(hapt_motorTorque + hapt_frictionTorque
+                   + hapt_feedforwardTorque + hapt_effectsTorque);
+
+    // sending the channels of the architecture, and the selected ones, to the
+    // other nodes
+    localState.position = hapt_encoderPaddleAngle;
+    localState.velocity = hapt_paddleSpeed;
+    localState.current = torq_GetCurrent();
+    localState.wave = hapt_outgoingWave;
+    localState.energy = couplingPort.inputEnergy;
+
+    // the observed torque is the one of the contact, opposed to the motor
+    // torque needed to balance it
+    if(hapt_sendObservedTorque)
+        localState.torque = -hapt_externalTorque;
+    else
+        localState.torque = hapt_motorTorque;
+
+    txChannels = hapt_architectureChannels[architecture];
+
+    if(hapt_waveMode != WAVE_OFF)
+        txChannels |= TLINK_WAVE;
+
+    if(hapt_passivityEnabled)
+        txChannels |= TLINK_ENERGY;
+
+    // the extra channels are only added while they fit in the link budget,
+    // from the lowest bit
+    for(extraChannel = TLINK_POSITION; extraChannel <= TLINK_ENERGY;
+        extraChannel <<= 1)
     {
-    	hapt_motorTorque = 0.0f;
+        if((hapt_txChannels & extraChannel) && !(txChannels & extraChannel)
+           && tlink_GetFrameSize(txChannels | extraChannel)
+              <= tlink_GetFrameBudget())
+            txChannels |= extraChannel;
     }
 
-	// saturation block
-	if(hapt_motorTorque > 0.032){
-		hapt_motorTorque = 0.032;
-	}
-	else if(hapt_motorTorque < -0.032){
-		hapt_motorTorque = -0.032;
-	}
-	torq_SetTorque(hapt_motorTorque);
-
-    //updating the previous values
-    position_error_prev = position_error;
-    hapt_encoderPaddleAngle_prev = hapt_encoderPaddleAngle;
-    temp_float32_prev = temp_float32;
+    tlink_SendState(&localState, txChannels);
 }
 
-float32_t lowPass(float32_t curr, float32_t prev, float32_t dt){
+/**
+  * @brief Reads the last state received from each node, and updates the
+  * predictors of their position, torque and wave.
+  * The wave variables and the passivity controller couple this board to the
+  * neighbour node only.
+  * @param localNode ID of this board.
+  */
+void hapt_ReadNodeStates(uint8_t localNode)
+{
+    int i;
 
-	float32_t tau = 1 / (2 * M_PI * CUT_OFF);
-	float32_t alpha = dt / (dt + tau);
+    hapt_neighbourNode = hapt_SelectNeighbourNode(localNode);
 
-	return curr*alpha + prev*(1-alpha);
+    for(i=0; i<TLINK_MAX_NODES; i++)
+    {
+        tlink_State *nodeState = (tlink_State*)&hapt_nodeStates[i];
+
+        if(i == localNode || !tlink_GetState(i, nodeState))
+            continue;
+
+        if(nodeState->channels & TLINK_POSITION)
+        {
+            pred_AddSample(&positionPredictors[i], nodeState->position,
+                           nodeState->timestamp);
+
+            if(nodeState->channels & TLINK_VELOCITY)
+                pred_SetSlope(&positionPredictors[i], nodeState->velocity);
+        }
+
+        if(nodeState->channels & TLINK_TORQUE)
+        {
+            pred_AddSample(&torquePredictors[i], nodeState->torque,
+                           nodeState->timestamp);
+        }
+
+        if(i != hapt_neighbourNode)
+            continue;
+
+        if(nodeState->channels & TLINK_ENERGY)
+            tdpa_SetRemoteEnergy(&couplingPort, nodeState->energy);
+
+        // the wave is held, not extrapolated, to keep the link passive
+        if(nodeState->channels & TLINK_WAVE)
+        {
+            pred_AddSample(&wavePredictor, nodeState->wave, nodeState->timestamp);
+            pred_SetSlope(&wavePredictor, 0.0f);
+        }
+    }
+
+    hapt_neighbourState = hapt_nodeStates[hapt_neighbourNode];
+    hapt_neighbourClockSync = *tlink_GetClockSync(hapt_neighbourNode);
+    hapt_neighbourTime = tlink_GetNodeTime(hapt_neighbourNode, hapt_timestamp);
 }
 
-float32_t PID(float32_t position_error, float32_t position_error_prev, float32_t dt){
-	static float32_t error_sum = 0.0f;
-	error_sum += position_error*dt;
+/**
+  * @brief Selects the neighbour node, which is the coupled node with the
+  * largest weight.
+  * @param localNode ID of this board.
+  * @return the ID of the neighbour node. If no node is coupled, the other node
+  * of a two-node ring is returned.
+  */
+uint8_t hapt_SelectNeighbourNode(uint8_t localNode)
+{
+    uint8_t neighbourNode = (localNode == 0) ? 1 : 0;
+    float32_t maxWeight = 0.0f;
+    int i;
+
+    for(i=0; i<TLINK_MAX_NODES; i++)
+    {
+        if(i != localNode && hapt_couplingWeights[i] > maxWeight)
+        {
+            neighbourNode = i;
+            maxWeight = hapt_couplingWeights[i];
+        }
+    }
 
-	return Kp*position_error + Kd*(position_error-position_error_prev)/dt + Ki*error_sum;
+    return neighbourNode;
 }
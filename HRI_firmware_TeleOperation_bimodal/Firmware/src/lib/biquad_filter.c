@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2021 EPFL-REHAssist (Rehabilitation and Assistive Robotics Group).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "biquad_filter.h"
+#include "utils.h"
+
+#define BQF_MAX_CUTOFF_RATIO 0.45f // Max cut-off frequency, relative to the sampling frequency.
+
+const float32_t bqf_butterworthQ[2][2] = // Quality factors of the Butterworth second-order sections.
+{
+    { 0.70710678f, 0.0f }, // Order 2. For order 3, 1.0 is used instead.
+    { 0.54119610f, 1.30656296f } // Order 4.
+};
+
+void bqf_UpdateCoefficients(bqf_Filter *filter, float32_t dt);
+float32_t bqf_CascadeDf2T(const float32_t *coefs, float32_t *state,
+                          uint8_t nStages, float32_t input);
+
+/**
+  * @brief Initializes a biquad cascade filter.
+  * @param filter: pointer to the filter structure.
+  * @param type: type of filter (BQF_NONE, BQF_LOW_PASS, BQF_HIGH_PASS or
+  * BQF_NOTCH).
+  * @param order: order of the filter (1 to BQF_MAX_ORDER).
+  * @param cutoff: cut-off frequency, or center frequency of the notch [Hz].
+  * @param quality: quality factor of the notch, unused by the other types.
+  */
+void bqf_Init(bqf_Filter *filter, uint8_t type, uint8_t order,
+              float32_t cutoff, float32_t quality)
+{
+    if(type >= BQF_N_TYPES || order < 1 || order > BQF_MAX_ORDER)
+        utils_TrapCpu(); // Invalid parameters.
+
+    filter->type = type;
+    filter->order = order;
+    filter->cutoff = cutoff;
+    filter->quality = quality;
+
+    // Force the computation of the coefficients at the first step, and the
+    // restart from its input.
+    filter->nStages = 0;
+    filter->coefType = BQF_N_TYPES;
+    filter->coefOrder = order;
+    filter->coefCutoff = cutoff;
+    filter->coefQuality = quality;
+    filter->coefDt = 0.0f;
+
+    bqf_Reset(filter, 0.0f);
+}
+
+/**
+  * @brief Steps a biquad cascade filter.
+  * @param filter: pointer to the filter structure.
+  * @param input: new value of the signal to filter.
+  * @param dt: timestep (time since the last call of this function) [s].
+  * @retval the filtered value.
+  */
+float32_t bqf_Step(bqf_Filter *filter, float32_t input, float32_t dt)
+{
+    // Recompute the coefficients only if a parameter changed.
+    if(filter->type != filter->coefType || filter->order != filter->coefOrder ||
+       filter->cutoff != filter->coefCutoff ||
+       filter->quality != filter->coefQuality || dt != filter->coefDt)
+    {
+        bool restart = (filter->type != filter->coefType ||
+                        filter->order != filter->coefOrder);
+
+        bqf_UpdateCoefficients(filter, dt);
+
+        if(restart)
+            bqf_Reset(filter, input);
+    }
+
+    filter->output = bqf_CascadeDf2T(filter->coefs, filter->state,
+                                     filter->nStages, input);
+
+    return filter->output;
+}
+
+/**
+  * @brief Sets the state of a biquad cascade filter, as if the given value was
+  * its input for a long time.
+  * @param filter: pointer to the filter structure.
+  * @param value: constant value of the signal to filter.
+  */
+void bqf_Reset(bqf_Filter *filter, float32_t value)
+{
+    int i;
+
+    for(i=0; i<filter->nStages; i++)
+    {
+        const float32_t *c = &filter->coefs[5*i];
+        float32_t *d = &filter->state[2*i];
+        float32_t dcGain = (c[0] + c[1] + c[2]) / (1.0f - c[3] - c[4]);
+        float32_t output = dcGain * value;
+
+        // y = b0*x + d1, d1 = b1*x - a1*y + d2, d2 = b2*x - a2*y.
+        d[1] = c[2] * value + c[4] * output;
+        d[0] = output - c[0] * value;
+
+        value = output;
+    }
+
+    filter->output = value;
+}
+
+/**
+  * @brief Computes the coefficients of each stage of a biquad cascade filter.
+  * @param filter: pointer to the filter structure.
+  * @param dt: new timestep [s].
+  */
+void bqf_UpdateCoefficients(bqf_Filter *filter, float32_t dt)
+{
+    float32_t cutoff = filter->cutoff;
+    float32_t k, k2;
+    uint8_t order = filter->order;
+    int i;
+
+    if(dt <= 0.0f)
+    {
+        utils_TrapCpu(); // Invalid timestep.
+        return;
+    }
+
+    filter->coefType = filter->type;
+    filter->coefOrder = filter->order;
+    filter->coefCutoff = filter->cutoff;
+    filter->coefQuality = filter->quality;
+    filter->coefDt = dt;
+
+    // Invalid parameters make a pass-through filter.
+    if(filter->type == BQF_NONE || filter->type >= BQF_N_TYPES ||
+       order < 1 || order > BQF_MAX_ORDER || cutoff <= 0.0f ||
+       (filter->type == BQF_NOTCH && filter->quality <= 0.0f))
+    {
+        filter->nStages = 0;
+        return;
+    }
+
+    // Prewarped cut-off frequency, that can not exceed the Nyquist frequency.
+    utils_SaturateF(&cutoff, 0.0f, BQF_MAX_CUTOFF_RATIO / dt);
+    k = tanf((float32_t)M_PI * cutoff * dt);
+    k2 = k * k;
+
+    filter->nStages = (order + 1) / 2;
+
+    for(i=0; i<filter->nStages; i++)
+    {
+        float32_t *c = &filter->coefs[5*i];
+
+        if(filter->type != BQF_NOTCH && (order % 2) == 1 &&
+           i == filter->nStages - 1)
+        {
+            // First-order section.
+            float32_t norm = 1.0f / (1.0f + k);
+
+            if(filter->type == BQF_LOW_PASS)
+            {
+                c[0] = k * norm;
+                c[1] = c[0];
+            }
+            else
+            {
+                c[0] = norm;
+                c[1] = -c[0];
+            }
+
+            c[2] = 0.0f;
+            c[3] = (1.0f - k) * norm;
+            c[4] = 0.0f;
+        }
+        else
+        {
+            // Second-order section.
+            float32_t q, norm;
+
+            if(filter->type == BQF_NOTCH)
+                q = filter->quality;
+            else if(order == 3)
+                q = 1.0f;
+            else
+                q = bqf_butterworthQ[order/2 - 1][i];
+
+            norm = 1.0f / (1.0f + k / q + k2);
+
+            if(filter->type == BQF_LOW_PASS)
+            {
+                c[0] = k2 * norm;
+                c[1] = 2.0f * c[0];
+                c[2] = c[0];
+            }
+            else if(filter->type == BQF_HIGH_PASS)
+            {
+                c[0] = norm;
+                c[1] = -2.0f * c[0];
+                c[2] = c[0];
+            }
+            else
+            {
+                c[0] = (1.0f + k2) * norm;
+                c[1] = 2.0f * (k2 - 1.0f) * norm;
+                c[2] = c[0];
+            }
+
+            c[3] = -2.0f * (k2 - 1.0f) * norm;
+            c[4] = -(1.0f - k / q + k2) * norm;
+        }
+    }
+}
+
+/**
+  * @brief Filters one sample through a cascade of biquads, in transposed
+  * direct form II.
+  * @param coefs: coefficients {b0, b1, b2, -a1, -a2} of each stage.
+  * @param state: state {d1, d2} of each stage.
+  * @param nStages: number of stages.
+  * @param input: new value of the signal to filter.
+  * @retval the filtered value.
+  */
+float32_t bqf_CascadeDf2T(const float32_t *coefs, float32_t *state,
+                          uint8_t nStages, float32_t input)
+{
+    float32_t output = input;
+
+    while(nStages > 0)
+    {
+        float32_t b0 = coefs[0], b1 = coefs[1], b2 = coefs[2],
+                  a1 = coefs[3], a2 = coefs[4];
+        float32_t d1 = state[0], d2 = state[1];
+
+        output = b0 * input + d1;
+        state[0] = b1 * input + a1 * output + d2;
+        state[1] = b2 * input + a2 * output;
+
+        input = output;
+        coefs += 5;
+        state += 2;
+        nStages--;
+    }
+
+    return output;
+}
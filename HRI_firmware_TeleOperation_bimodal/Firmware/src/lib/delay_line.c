@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2021 EPFL-REHAssist (Rehabilitation and Assistive Robotics Group).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "delay_line.h"
+#include "utils.h"
+
+/**
+ * @brief Initializes a dl_DelayLine structure.
+ * The buffer has to be provided by the user, to avoid dynamic memory
+ * allocation.
+ * @param dl the dl_DelayLine structure to initialize.
+ * @param buffer pointer to an existing array.
+ * @param bufferSize length of the given array.
+ * @param initialValue value of all the samples in the buffer, until it is
+ * filled by dl_Step().
+ */
+void dl_Init(dl_DelayLine *dl, float32_t *buffer, uint16_t bufferSize,
+             float32_t initialValue)
+{
+    uint16_t i;
+
+    if(bufferSize < 2)
+    {
+        utils_TrapCpu(); // Error, the buffer can not hold any delayed sample.
+        return;
+    }
+
+    dl->buffer = buffer;
+    dl->bufferSize = bufferSize;
+    dl->writeIndex = 0;
+    dl->delay = 0.0f;
+    dl->maxSlewRate = DL_DEFAULT_MAX_SLEW_RATE;
+
+    for(i=0; i<bufferSize; i++)
+        dl->buffer[i] = initialValue;
+}
+
+/**
+ * @brief Adds a new sample to the delay line, and gets the delayed one.
+ * @param dl the dl_DelayLine to step.
+ * @param input the new sample.
+ * @param delay the target delay. It will be saturated to the max delay, see
+ * dl_GetMaxDelay().
+ * @param samplingPeriod time elapsed since the last call, in the same unit as
+ * delay.
+ * @return the sample delayed by the actual delay, linearly interpolated.
+ */
+float32_t dl_Step(dl_DelayLine *dl, float32_t input, float32_t delay,
+                  float32_t samplingPeriod)
+{
+    float32_t targetDelay, delayChange, fraction, newer, older;
+    uint16_t integerDelay, newerIndex, olderIndex;
+
+    // Convert the target delay to a number of samples.
+    targetDelay = delay / samplingPeriod;
+    utils_SaturateF(&targetDelay, 0.0f, (float32_t)(dl->bufferSize - 1));
+
+    // Move the actual delay towards the target, at a limited rate.
+    delayChange = targetDelay - dl->delay;
+    utils_SaturateF(&delayChange, -dl->maxSlewRate, dl->maxSlewRate);
+    dl->delay += delayChange;
+
+    // Write the new sample.
+    dl->buffer[dl->writeIndex] = input;
+
+    // Interpolate between the two samples surrounding the delay.
+    integerDelay = (uint16_t)dl->delay;
+    fraction = dl->delay - (float32_t)integerDelay;
+
+    if(integerDelay <= dl->writeIndex)
+        newerIndex = dl->writeIndex - integerDelay;
+    else
+        newerIndex = dl->writeIndex + dl->bufferSize - integerDelay;
+
+    if(newerIndex > 0)
+        olderIndex = newerIndex - 1;
+    else
+        olderIndex = dl->bufferSize - 1;
+
+    newer = dl->buffer[newerIndex];
+    older = dl->buffer[olderIndex];
+
+    // Advance the write index.
+    dl->writeIndex++;
+
+    if(dl->writeIndex >= dl->bufferSize)
+        dl->writeIndex = 0;
+
+    return newer + fraction * (older - newer);
+}
+
+/**
+ * @brief Gets the longest delay that the delay line can produce.
+ * @param dl the dl_DelayLine to query.
+ * @param samplingPeriod the sampling period.
+ * @return the max delay, in the same unit as samplingPeriod.
+ */
+float32_t dl_GetMaxDelay(dl_DelayLine *dl, float32_t samplingPeriod)
+{
+    return (float32_t)(dl->bufferSize - 1) * samplingPeriod;
+}
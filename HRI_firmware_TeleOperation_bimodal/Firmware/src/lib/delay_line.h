@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2021 EPFL-REHAssist (Rehabilitation and Assistive Robotics Group).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __DELAY_LINE_H
+#define __DELAY_LINE_H
+
+#include "../main.h"
+
+/** @defgroup DelayLine Lib / Delay line
+  * @brief Time-based delay of a sampled signal, with fractional interpolation.
+  *
+  * This module delays a float signal sampled at a regular rate. The delay is
+  * given as a duration, not as a number of samples, so it stays the same if
+  * the sampling period changes. If it is not an integer multiple of the
+  * sampling period, the output is linearly interpolated between the two
+  * nearest samples.
+  *
+  * When the delay is changed, the actual delay moves towards the new value at
+  * a limited rate (see maxSlewRate), so the output does not jump: the signal
+  * is just played back slightly faster or slower during the transition.
+  *
+  * Create a dl_DelayLine structure, and initialize it with dl_Init(). Then,
+  * call dl_Step() once per sampling period.
+  *
+  * @ingroup Lib
+  * @addtogroup DelayLine
+  * @{
+  */
+
+#define DL_DEFAULT_MAX_SLEW_RATE 0.5f ///< Default max delay change per sample [sample/sample].
+
+/**
+ * @brief Delay line structure.
+ */
+typedef struct
+{
+    float32_t *buffer; ///< Pointer to the samples buffer.
+    uint16_t bufferSize; ///< Size of buffer. The max delay is (bufferSize-1) samples.
+    uint16_t writeIndex; ///< Index where the next sample will be written.
+    float32_t delay; ///< Actual delay [sample].
+    float32_t maxSlewRate; ///< Max change of the delay at each step [sample]. Must be lower than 1.
+} dl_DelayLine;
+
+void dl_Init(dl_DelayLine *dl, float32_t *buffer, uint16_t bufferSize,
+             float32_t initialValue);
+float32_t dl_Step(dl_DelayLine *dl, float32_t input, float32_t delay,
+                  float32_t samplingPeriod);
+float32_t dl_GetMaxDelay(dl_DelayLine *dl, float32_t samplingPeriod);
+
+/**
+  * @}
+  */
+
+#endif
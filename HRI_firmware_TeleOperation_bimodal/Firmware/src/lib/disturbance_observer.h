@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2021 EPFL-REHAssist (Rehabilitation and Assistive Robotics Group).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __DISTURBANCE_OBSERVER_H
+#define __DISTURBANCE_OBSERVER_H
+
+#include "../main.h"
+
+/** @defgroup DisturbanceObserver Lib / Disturbance observer
+  * @brief Estimation of the external torque applied to the paddle, from the
+  * motor torque and the velocity, without force sensor.
+  *
+  * With the nominal model J*dw/dt = T_motor + T_ext - B*w - T_friction, the
+  * external torque is T_ext = J*dw/dt + B*w + T_friction - T_motor. The
+  * observer low-pass filters this torque at the cut-off frequency g, and
+  * avoids differentiating the velocity by filtering
+  * B*w + T_friction - T_motor - g*J*w instead, then adding g*J*w back.
+  *
+  * The estimate contains the torque of the operator or of the contact, but
+  * also the errors of the model (unmodelled friction, inertia error...).
+  *
+  * Create a dob_Observer structure, and initialize it with dob_Init(). Then,
+  * call dob_Step() at every control tick.
+  *
+  * @ingroup Lib
+  * @addtogroup DisturbanceObserver
+  * @{
+  */
+
+/**
+ * @brief Disturbance observer.
+ */
+typedef struct
+{
+    float32_t inertia; ///< Nominal inertia J [N.m/(deg/s^2)].
+    float32_t damping; ///< Nominal viscous damping B [N.m/(deg/s)].
+    float32_t cutoff; ///< Cut-off frequency g of the observer [Hz].
+    float32_t filterState; ///< Low-pass filtered torque, without the g*J*w term [N.m].
+    float32_t externalTorque; ///< External torque estimated at the last step [N.m].
+} dob_Observer;
+
+void dob_Init(dob_Observer *observer, float32_t inertia, float32_t damping,
+              float32_t cutoff);
+float32_t dob_Step(dob_Observer *observer, float32_t motorTorque,
+                   float32_t velocity, float32_t frictionTorque, float32_t dt);
+
+/**
+  * @}
+  */
+
+#endif
@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2021 EPFL-REHAssist (Rehabilitation and Assistive Robotics Group).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "haptic_effects.h"
+#include "utils.h"
+
+float32_t hfx_EffectTorque(hfx_Engine *engine, int index, float32_t angle,
+                           float32_t velocity);
+float32_t hfx_TableTorque(hfx_Engine *engine, int index, float32_t angle);
+
+/**
+ * @brief Initializes a hfx_Engine structure, without any effect.
+ * @param engine the hfx_Engine structure to initialize.
+ */
+void hfx_Init(hfx_Engine *engine)
+{
+    int i;
+
+    for(i=0; i<HFX_MAX_EFFECTS; i++)
+    {
+        engine->types[i] = HFX_NONE;
+        engine->positions[i] = 0.0f;
+        engine->stiffnesses[i] = 0.0f;
+        engine->dampings[i] = 0.0f;
+        engine->widths[i] = 0.0f;
+        engine->maxTorques[i] = 0.0f;
+    }
+
+    for(i=0; i<HFX_TABLE_SIZE; i++)
+        engine->table[i] = 0.0f;
+
+    engine->nActiveEffects = 0;
+}
+
+/**
+ * @brief Computes the torque of all the active effects.
+ * @param engine the effects engine.
+ * @param angle the paddle angle [deg].
+ * @param velocity the paddle velocity [deg/s].
+ * @return the sum of the torques of the effects [N.m].
+ */
+float32_t hfx_Step(hfx_Engine *engine, float32_t angle, float32_t velocity)
+{
+    float32_t torque = 0.0f;
+    uint8_t nActiveEffects = 0;
+    int i;
+
+    for(i=0; i<HFX_MAX_EFFECTS; i++)
+    {
+        float32_t effectTorque;
+
+        if(engine->types[i] == HFX_NONE || engine->types[i] >= HFX_N_TYPES)
+            continue;
+
+        effectTorque = hfx_EffectTorque(engine, i, angle, velocity);
+
+        if(engine->maxTorques[i] > 0.0f)
+        {
+            utils_SaturateF(&effectTorque, -engine->maxTorques[i],
+                            engine->maxTorques[i]);
+        }
+
+        torque += effectTorque;
+        nActiveEffects++;
+    }
+
+    engine->nActiveEffects = nActiveEffects;
+
+    return torque;
+}
+
+/**
+ * @brief Computes the torque of one effect.
+ * @param engine the effects engine.
+ * @param index the slot of the effect.
+ * @param angle the paddle angle [deg].
+ * @param velocity the paddle velocity [deg/s].
+ * @return the torque of the effect, not saturated [N.m].
+ */
+float32_t hfx_EffectTorque(hfx_Engine *engine, int index, float32_t angle,
+                           float32_t velocity)
+{
+    float32_t position = engine->positions[index];
+    float32_t stiffness = engine->stiffnesses[index];
+    float32_t damping = engine->dampings[index];
+    float32_t width = engine->widths[index];
+
+    switch(engine->types[index])
+    {
+    case HFX_WALL_MIN:
+        if(angle >= position)
+            return 0.0f;
+        else if(velocity < 0.0f)
+            return stiffness * (position - angle) - damping * velocity;
+        else
+            return stiffness * (position - angle);
+
+    case HFX_WALL_MAX:
+        if(angle <= position)
+            return 0.0f;
+        else if(velocity > 0.0f)
+            return stiffness * (position - angle) - damping * velocity;
+        else
+            return stiffness * (position - angle);
+
+    case HFX_SPRING:
+        return stiffness * (position - angle) - damping * velocity;
+
+    case HFX_DAMPER:
+        return -damping * velocity;
+
+    case HFX_DETENT:
+        if(width <= 0.0f)
+            return -damping * velocity;
+
+        return -engine->maxTorques[index]
+               * sinf(2.0f * (float32_t)M_PI * (angle - position) / width)
+               - damping * velocity;
+
+    case HFX_TABLE:
+        return hfx_TableTorque(engine, index, angle) - damping * velocity;
+
+    default:
+        return 0.0f;
+    }
+}
+
+/**
+ * @brief Interpolates the torque of a HFX_TABLE effect.
+ * @param engine the effects engine.
+ * @param index the slot of the effect.
+ * @param angle the paddle angle [deg].
+ * @return the torque interpolated from the table, or zero outside of the angle
+ * range of the effect [N.m].
+ */
+float32_t hfx_TableTorque(hfx_Engine *engine, int index, float32_t angle)
+{
+    float32_t position, fraction;
+    int tableIndex;
+
+    if(engine->widths[index] <= 0.0f)
+        return 0.0f;
+
+    position = (angle - engine->positions[index]) / engine->widths[index]
+               * (float32_t)(HFX_TABLE_SIZE - 1);
+
+    if(position < 0.0f || position > (float32_t)(HFX_TABLE_SIZE - 1))
+        return 0.0f;
+
+    tableIndex = (int)position;
+
+    if(tableIndex >= HFX_TABLE_SIZE - 1)
+        return engine->table[HFX_TABLE_SIZE - 1];
+
+    fraction = position - (float32_t)tableIndex;
+
+    return engine->table[tableIndex]
+           + fraction * (engine->table[tableIndex+1] - engine->table[tableIndex]);
+}
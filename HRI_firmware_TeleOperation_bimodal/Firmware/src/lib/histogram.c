@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2021 EPFL-REHAssist (Rehabilitation and Assistive Robotics Group).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "histogram.h"
+#include "utils.h"
+
+/**
+ * @brief Initializes a hist_Histogram structure, with all the counts to zero.
+ * @param hist the hist_Histogram structure to initialize.
+ * @param min lower bound of the first bucket.
+ * @param binWidth width of a bucket. Must be greater than zero.
+ */
+void hist_Init(hist_Histogram *hist, int32_t min, uint32_t binWidth)
+{
+    if(binWidth == 0)
+    {
+        utils_TrapCpu(); // Error, the buckets can not be empty.
+        return;
+    }
+
+    hist->min = min;
+    hist->binWidth = binWidth;
+    hist_Reset(hist);
+}
+
+/**
+ * @brief Sets all the counts of a histogram to zero.
+ * @param hist the histogram to reset.
+ */
+void hist_Reset(hist_Histogram *hist)
+{
+    int i;
+
+    for(i=0; i<HIST_N_BINS; i++)
+        hist->counts[i] = 0;
+}
+
+/**
+ * @brief Counts a new value in the corresponding bucket.
+ * @param hist the histogram to update.
+ * @param value the new value. If it is outside of the histogram range, it is
+ * counted in the first or the last bucket.
+ */
+void hist_Add(hist_Histogram *hist, int32_t value)
+{
+    uint32_t binIndex;
+
+    // The difference is computed on unsigned integers, to avoid the overflow
+    // for the values far from the range.
+    if(value < hist->min)
+        binIndex = 0;
+    else
+    {
+        binIndex = ((uint32_t)value - (uint32_t)hist->min) / hist->binWidth;
+
+        if(binIndex >= HIST_N_BINS)
+            binIndex = HIST_N_BINS - 1;
+    }
+
+    // Saturate the count, instead of wrapping around to zero.
+    if(hist->counts[binIndex] < UINT32_MAX)
+        hist->counts[binIndex]++;
+}
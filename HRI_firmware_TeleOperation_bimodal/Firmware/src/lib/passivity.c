@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2021 EPFL-REHAssist (Rehabilitation and Assistive Robotics Group).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "passivity.h"
+#include "utils.h"
+
+/**
+ * @brief Initializes a tdpa_Port structure, with all the energies to zero.
+ * @param port the tdpa_Port structure to initialize.
+ * @param maxDamping max damping that can be injected [N.m/(deg/s)].
+ */
+void tdpa_Init(tdpa_Port *port, float32_t maxDamping)
+{
+    port->inputEnergy = 0.0;
+    port->outputEnergy = 0.0;
+    port->remoteInputEnergy = 0.0;
+    port->observedEnergy = 0.0;
+    port->damping = 0.0f;
+    port->maxDamping = maxDamping;
+}
+
+/**
+ * @brief Sets the input energy of the other port, received from its board.
+ * @param port the local port.
+ * @param remoteInputEnergy the energy that entered the coupling through the
+ * other port [N.m.deg].
+ */
+void tdpa_SetRemoteEnergy(tdpa_Port *port, double remoteInputEnergy)
+{
+    port->remoteInputEnergy = remoteInputEnergy;
+}
+
+/**
+ * @brief Updates the energies, and adds damping if the coupling is active.
+ * @param port the local port.
+ * @param torque the torque that the coupling applies to the local paddle
+ * [N.m].
+ * @param velocity the local paddle velocity [deg/s].
+ * @param dt time elapsed since the last call [s].
+ * @return the torque to apply, including the damping [N.m].
+ */
+float32_t tdpa_Step(tdpa_Port *port, float32_t torque, float32_t velocity,
+                    float32_t dt)
+{
+    // Power flowing into the coupling, from the paddle.
+    float32_t power = -torque * velocity;
+
+    if(power >= 0.0f)
+        port->inputEnergy += (double)(power * dt);
+    else
+        port->outputEnergy -= (double)(power * dt);
+
+    port->observedEnergy = port->remoteInputEnergy - port->outputEnergy;
+
+    // Dissipate the energy generated by the coupling, with a damping torque.
+    port->damping = 0.0f;
+
+    if(port->observedEnergy < 0.0 && fabsf(velocity) > TDPA_MIN_VELOCITY)
+    {
+        float32_t damping = (float32_t)(-port->observedEnergy)
+                            / (velocity * velocity * dt);
+
+        utils_SaturateF(&damping, 0.0f, port->maxDamping);
+
+        port->damping = damping;
+        port->outputEnergy -= (double)(damping * velocity * velocity * dt);
+        port->observedEnergy = port->remoteInputEnergy - port->outputEnergy;
+
+        torque -= damping * velocity;
+    }
+
+    return torque;
+}
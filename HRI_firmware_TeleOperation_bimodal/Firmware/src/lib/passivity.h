@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2021 EPFL-REHAssist (Rehabilitation and Assistive Robotics Group).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __PASSIVITY_H
+#define __PASSIVITY_H
+
+#include "../main.h"
+
+/** @defgroup Passivity Lib / Passivity
+  * @brief Time-domain passivity observer and controller, for a two-port
+  * coupling whose ports are on different boards.
+  *
+  * The observer integrates the power flow at the local port of the coupling,
+  * separately for the energy that enters the coupling (inputEnergy) and the
+  * energy that leaves it (outputEnergy). The input energy is sent to the other
+  * board. Since the energy can not leave the coupling before it entered it,
+  * the coupling stays passive as long as the local output energy is lower than
+  * the input energy received from the other port, whatever the delay.
+  *
+  * When the observed energy (remote input minus local output) becomes
+  * negative, the controller adds a damping torque, just large enough to
+  * dissipate the excess energy. The damping is limited to maxDamping.
+  *
+  * Create a tdpa_Port structure, and initialize it with tdpa_Init(). Then,
+  * call tdpa_SetRemoteEnergy() every time the input energy of the other port
+  * is received, and tdpa_Step() once per control tick, with the torque
+  * computed by the coupling.
+  *
+  * @ingroup Lib
+  * @addtogroup Passivity
+  * @{
+  */
+
+#define TDPA_MIN_VELOCITY 0.01f ///< Speed under which no damping is injected, to avoid dividing by zero [deg/s].
+
+/**
+ * @brief Passivity observer and controller for one port.
+ */
+typedef struct
+{
+    double inputEnergy; ///< Energy that entered the coupling through the local port [N.m.deg].
+    double outputEnergy; ///< Energy that left the coupling through the local port, minus the dissipated energy [N.m.deg].
+    double remoteInputEnergy; ///< Last input energy received from the other port [N.m.deg].
+    double observedEnergy; ///< remoteInputEnergy - outputEnergy, negative if the coupling is active [N.m.deg].
+    float32_t damping; ///< Damping injected at the last step [N.m/(deg/s)].
+    float32_t maxDamping; ///< Max damping that can be injected [N.m/(deg/s)].
+} tdpa_Port;
+
+void tdpa_Init(tdpa_Port *port, float32_t maxDamping);
+void tdpa_SetRemoteEnergy(tdpa_Port *port, double remoteInputEnergy);
+float32_t tdpa_Step(tdpa_Port *port, float32_t torque, float32_t velocity,
+                    float32_t dt);
+
+/**
+  * @}
+  */
+
+#endif
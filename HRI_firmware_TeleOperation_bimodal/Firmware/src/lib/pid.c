@@ -79,3 +79,151 @@ float32_t pid_Step(pid_Pid *pid, float32_t current, float32_t target, float32_t
     
     return pid->command;
 }
+
+void pid_UpdateCoefficients(pid_DiscretePid *pid, float32_t dt);
+
+/**
+  * @brief Initializes the discrete PID structure.
+  * @param pid: pointer to the discrete PID structure.
+  * @param kp: proportional gain.
+  * @param ki: integral gain [1/s].
+  * @param kd: derivative gain [s].
+  * @param derivativeCutoff: cut-off frequency of the derivative low-pass
+  * filter, 0 to disable [Hz].
+  * @param commandMin: min value of the command.
+  * @param commandMax: max value of the command.
+  */
+void pid_InitDiscrete(pid_DiscretePid *pid, float32_t kp, float32_t ki,
+                      float32_t kd, float32_t derivativeCutoff,
+                      float32_t commandMin, float32_t commandMax)
+{
+    if(commandMin > commandMax || derivativeCutoff < 0.0f)
+        utils_TrapCpu(); // Invalid parameters.
+
+    pid->kp = kp;
+    pid->ki = ki;
+    pid->kd = kd;
+    pid->derivativeCutoff = derivativeCutoff;
+    pid->derivativeTargetWeight = 0.0f;
+    pid->commandMin = commandMin;
+    pid->commandMax = commandMax;
+    pid->command = 0.0f;
+
+    // Force the computation of the coefficients at the first step.
+    pid->coefDt = 0.0f;
+    pid->coefKp = kp;
+
+    pid_ResetDiscrete(pid, 0.0f, 0.0f);
+}
+
+/**
+  * @brief Resets the state of the discrete PID, so that the next step starts
+  * from a zero command, without derivative kick.
+  * @param pid: pointer to the discrete PID structure.
+  * @param measurement: current state of the system to control.
+  * @param target: desired state of the system to control.
+  */
+void pid_ResetDiscrete(pid_DiscretePid *pid, float32_t measurement,
+                       float32_t target)
+{
+    pid->integrator = 0.0f;
+    pid->derivative = 0.0f;
+    pid->previousDerivativeInput = pid->derivativeTargetWeight * target
+                                   - measurement;
+    pid->previousError = target - measurement;
+    pid->command = 0.0f;
+}
+
+/**
+  * @brief Steps the discrete PID.
+  * @param pid: pointer to the discrete PID structure.
+  * @param measurement: current state of the system to control.
+  * @param target: desired state of the system to control.
+  * @param dt: timestep (time since the last call of this function) [s].
+  * @retval command to apply to the system, saturated.
+  */
+float32_t pid_StepDiscrete(pid_DiscretePid *pid, float32_t measurement,
+                           float32_t target, float32_t dt)
+{
+    float32_t err, derivativeInput, proportional, command;
+
+    // Recompute the coefficients only if a parameter changed.
+    if(pid->kp != pid->coefKp || pid->ki != pid->coefKi ||
+       pid->kd != pid->coefKd || pid->derivativeCutoff != pid->coefCutoff ||
+       dt != pid->coefDt)
+    {
+        pid_UpdateCoefficients(pid, dt);
+    }
+
+    err = target - measurement;
+
+    // Proportional part.
+    proportional = pid->kp * err;
+
+    // Filtered derivative part, on the measurement and a fraction of the
+    // target.
+    derivativeInput = pid->derivativeTargetWeight * target - measurement;
+    pid->derivative = pid->derivativeFilterCoef * pid->derivative
+                      + pid->derivativeCoef * (derivativeInput
+                                               - pid->previousDerivativeInput);
+    pid->previousDerivativeInput = derivativeInput;
+
+    // Integral part, frozen if the command saturates in the direction of the
+    // error (clamping anti-windup).
+    command = proportional + pid->integrator + pid->derivative;
+
+    if(!(command >= pid->commandMax && err > 0.0f) &&
+       !(command <= pid->commandMin && err < 0.0f))
+    {
+        pid->integrator += pid->integralCoef * err;
+        utils_SaturateF(&pid->integrator, pid->commandMin, pid->commandMax);
+        command = proportional + pid->integrator + pid->derivative;
+    }
+
+    utils_SaturateF(&command, pid->commandMin, pid->commandMax);
+
+    pid->previousError = err;
+    pid->command = command;
+
+    return command;
+}
+
+/**
+  * @brief Recomputes the coefficients of the discrete PID, after a change of
+  * the gains or of the timestep.
+  * If the PID has an integral action, the integrator absorbs the change of
+  * the proportional part, so the command does not jump.
+  * @param pid: pointer to the discrete PID structure.
+  * @param dt: new timestep [s].
+  */
+void pid_UpdateCoefficients(pid_DiscretePid *pid, float32_t dt)
+{
+    float32_t tau;
+
+    if(dt <= 0.0f)
+    {
+        utils_TrapCpu(); // Invalid timestep.
+        return;
+    }
+
+    // Bumpless gain change. Without integral action, the integrator would not
+    // decay, and would keep the offset forever.
+    if(pid->ki > 0.0f)
+        pid->integrator += (pid->coefKp - pid->kp) * pid->previousError;
+
+    // Backward Euler discretization of kd*s/(tau*s+1).
+    if(pid->derivativeCutoff > 0.0f)
+        tau = 1.0f / (2.0f * (float32_t)M_PI * pid->derivativeCutoff);
+    else
+        tau = 0.0f;
+
+    pid->integralCoef = pid->ki * dt;
+    pid->derivativeFilterCoef = tau / (tau + dt);
+    pid->derivativeCoef = pid->kd / (tau + dt);
+
+    pid->coefKp = pid->kp;
+    pid->coefKi = pid->ki;
+    pid->coefKd = pid->kd;
+    pid->coefCutoff = pid->derivativeCutoff;
+    pid->coefDt = dt;
+}
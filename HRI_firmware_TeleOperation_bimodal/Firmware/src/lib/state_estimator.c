@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2021 EPFL-REHAssist (Rehabilitation and Assistive Robotics Group).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "state_estimator.h"
+#include "utils.h"
+
+#define SEST_DEFAULT_RESIDUAL_CUTOFF 1.0f // Default cut-off frequency of the Hall residual filter [Hz].
+
+void sest_UpdateGains(sest_Estimator *estimator, float32_t dt);
+
+/**
+ * @brief Initializes a sest_Estimator structure. The state is set at the
+ * first step, and the Hall correction and the slip detection are disabled.
+ * @param estimator the sest_Estimator structure to initialize.
+ * @param bandwidth bandwidth of the encoder tracking [Hz].
+ * @param hallOffset Hall sensor voltage at the zero angle [V].
+ * @param hallGain Hall sensor sensitivity [deg/V].
+ */
+void sest_Init(sest_Estimator *estimator, float32_t bandwidth,
+               float32_t hallOffset, float32_t hallGain)
+{
+    estimator->bandwidth = bandwidth;
+    estimator->hallOffset = hallOffset;
+    estimator->hallGain = hallGain;
+    estimator->hallCorrectionCutoff = 0.0f;
+    estimator->residualCutoff = SEST_DEFAULT_RESIDUAL_CUTOFF;
+    estimator->slipThreshold = 0.0f;
+
+    estimator->position = 0.0f;
+    estimator->velocity = 0.0f;
+    estimator->acceleration = 0.0f;
+    estimator->encoderOffset = 0.0f;
+    estimator->encoderResidual = 0.0f;
+    estimator->hallResidual = 0.0f;
+    estimator->slipDetected = false;
+
+    estimator->gainsBandwidth = -1.0f; // Force the computation at the first step.
+    estimator->gainsDt = -1.0f;
+    estimator->initialized = false;
+}
+
+/**
+ * @brief Updates the state estimate with new measurements.
+ * @param estimator the state estimator.
+ * @param encoderAngle the angle measured by the encoder [deg].
+ * @param hallVoltage the output voltage of the Hall sensor [V].
+ * @param dt time elapsed since the last call [s].
+ */
+void sest_Step(sest_Estimator *estimator, float32_t encoderAngle,
+               float32_t hallVoltage, float32_t dt)
+{
+    float32_t hallAngle = (hallVoltage - estimator->hallOffset)
+                          * estimator->hallGain;
+    float32_t predictedPosition, predictedVelocity, hallError;
+
+    if(dt <= 0.0f)
+        return;
+
+    if(estimator->bandwidth != estimator->gainsBandwidth ||
+       dt != estimator->gainsDt)
+    {
+        sest_UpdateGains(estimator, dt);
+    }
+
+    // Start from the first measurement, at rest.
+    if(!estimator->initialized)
+    {
+        estimator->position = encoderAngle + estimator->encoderOffset;
+        estimator->initialized = true;
+    }
+
+    // Correct the offset of the encoder with the Hall angle (complementary
+    // filter), and compute the residual between both sensors.
+    hallError = hallAngle - (encoderAngle + estimator->encoderOffset);
+
+    if(estimator->hallCorrectionCutoff > 0.0f)
+    {
+        estimator->encoderOffset += (1.0f - expf(-2.0f * (float32_t)M_PI
+                                                 * estimator->hallCorrectionCutoff
+                                                 * dt))
+                                    * hallError;
+    }
+
+    if(estimator->residualCutoff > 0.0f)
+    {
+        estimator->hallResidual += (1.0f - expf(-2.0f * (float32_t)M_PI
+                                                * estimator->residualCutoff
+                                                * dt))
+                                   * (hallError - estimator->hallResidual);
+    }
+    else
+        estimator->hallResidual = hallError;
+
+    if(estimator->slipThreshold > 0.0f &&
+       fabsf(estimator->hallResidual) > estimator->slipThreshold)
+    {
+        estimator->slipDetected = true;
+    }
+
+    // Predict with the constant-acceleration model, then correct with the
+    // encoder angle.
+    predictedPosition = estimator->position + estimator->velocity * dt
+                        + 0.5f * estimator->acceleration * dt * dt;
+    predictedVelocity = estimator->velocity + estimator->acceleration * dt;
+
+    estimator->encoderResidual = encoderAngle + estimator->encoderOffset
+                                 - predictedPosition;
+
+    estimator->position = predictedPosition
+                          + estimator->positionGain * estimator->encoderResidual;
+    estimator->velocity = predictedVelocity
+                          + estimator->velocityGain * estimator->encoderResidual;
+    estimator->acceleration += estimator->accelerationGain
+                               * estimator->encoderResidual;
+}
+
+/**
+ * @brief Computes the steady-state gains of the critically damped
+ * alpha-beta-gamma filter, for the current bandwidth and timestep.
+ * @param estimator the state estimator.
+ * @param dt the timestep [s].
+ */
+void sest_UpdateGains(sest_Estimator *estimator, float32_t dt)
+{
+    float32_t bandwidth = estimator->bandwidth;
+    float32_t theta, oneMinusTheta;
+
+    utils_SaturateF(&bandwidth, 0.0f, 0.5f / dt);
+
+    theta = expf(-2.0f * (float32_t)M_PI * bandwidth * dt);
+    oneMinusTheta = 1.0f - theta;
+
+    estimator->positionGain = 1.0f - theta * theta * theta;
+    estimator->velocityGain = 1.5f * oneMinusTheta * oneMinusTheta
+                              * (1.0f + theta) / dt;
+    estimator->accelerationGain = oneMinusTheta * oneMinusTheta * oneMinusTheta
+                                  / (dt * dt);
+
+    estimator->gainsBandwidth = estimator->bandwidth;
+    estimator->gainsDt = dt;
+}
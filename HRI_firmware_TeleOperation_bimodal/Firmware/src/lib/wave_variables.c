@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2021 EPFL-REHAssist (Rehabilitation and Assistive Robotics Group).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "wave_variables.h"
+#include "utils.h"
+
+/**
+ * @brief Initializes a wave_Transform structure.
+ * @param wt the wave_Transform structure to initialize.
+ * @param impedance wave impedance b [N.m/(deg/s)]. Must be greater than zero.
+ * @param filterCutoff cut-off frequency of the incoming wave filter, or 0 to
+ * disable it [Hz].
+ */
+void wave_Init(wave_Transform *wt, float32_t impedance, float32_t filterCutoff)
+{
+    if(impedance <= 0.0f)
+    {
+        utils_TrapCpu(); // Error, the wave impedance must be positive.
+        return;
+    }
+
+    wt->impedance = impedance;
+    bqf_Init(&wt->filter, BQF_LOW_PASS, 1, filterCutoff, 0.0f);
+}
+
+/**
+ * @brief Low-pass filters the received wave (first order).
+ * @param wt the wave transformation.
+ * @param incomingWave the wave received from the other side.
+ * @param dt time elapsed since the last call [s].
+ * @return the filtered wave, or incomingWave if the filter is disabled.
+ */
+float32_t wave_Filter(wave_Transform *wt, float32_t incomingWave, float32_t dt)
+{
+    return bqf_Step(&wt->filter, incomingWave, dt);
+}
+
+/**
+ * @brief Clears the incoming wave filter, as if the received wave was zero.
+ * @param wt the wave transformation.
+ */
+void wave_Reset(wave_Transform *wt)
+{
+    bqf_Reset(&wt->filter, 0.0f);
+}
+
+/**
+ * @brief Computes the force to apply on the impedance side of the coupling.
+ * @param wt the wave transformation.
+ * @param velocity the local velocity [deg/s].
+ * @param incomingWave the wave received from the admittance side.
+ * @param force output: the force reflected by the admittance side [N.m].
+ * @return the wave to send to the admittance side.
+ */
+float32_t wave_ImpedanceStep(wave_Transform *wt, float32_t velocity,
+                             float32_t incomingWave, float32_t *force)
+{
+    float32_t b = wt->impedance;
+    float32_t sqrt2b;
+
+    if(b <= 0.0f) // The impedance may have been set to an invalid value.
+    {
+        *force = 0.0f;
+        return 0.0f;
+    }
+
+    sqrt2b = sqrtf(2.0f * b);
+
+    // F = b*v - sqrt(2b)*w, and u = (b*v + F) / sqrt(2b).
+    *force = b * velocity - sqrt2b * incomingWave;
+
+    return sqrt2b * velocity - incomingWave;
+}
+
+/**
+ * @brief Computes the velocity to track on the admittance side of the
+ * coupling.
+ * @param wt the wave transformation.
+ * @param force the force applied locally to track the velocity [N.m].
+ * @param incomingWave the wave received from the impedance side.
+ * @param velocity output: the velocity commanded by the impedance side
+ * [deg/s].
+ * @return the wave to send to the impedance side.
+ */
+float32_t wave_AdmittanceStep(wave_Transform *wt, float32_t force,
+                              float32_t incomingWave, float32_t *velocity)
+{
+    float32_t b = wt->impedance;
+    float32_t sqrt2b;
+
+    if(b <= 0.0f) // The impedance may have been set to an invalid value.
+    {
+        *velocity = 0.0f;
+        return 0.0f;
+    }
+
+    sqrt2b = sqrtf(2.0f * b);
+
+    // v = (sqrt(2b)*u - F) / b, and w = (b*v - F) / sqrt(2b).
+    *velocity = (sqrt2b * incomingWave - force) / b;
+
+    return incomingWave - 2.0f * force / sqrt2b;
+}
@@ -340,11 +340,11 @@ void HriBoard::onReceivedData()
                             VarAccess varAccess = (VarAccess)*p;
                             p++;
 
-                            //int varSize = (int)*p; // Size is ignored.
+                            int varSize = (int)*p;
                             p++;
 
                             syncVars.append(makeSyncVar(varType, i, varName,
-                                                        varAccess));
+                                                        varAccess, varSize));
                         }
 
                         //
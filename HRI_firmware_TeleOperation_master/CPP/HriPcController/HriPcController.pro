@@ -16,10 +16,12 @@ TEMPLATE = app
 
 SOURCES += main.cpp\
            mainwindow.cpp \
+           linkhistogramswidget.cpp \
     ../HriBoardLib/hriboard.cpp \
     ../HriBoardLib/syncvar.cpp
 
 HEADERS  += mainwindow.h \
+            linkhistogramswidget.h \
             ../../Firmware/src/definitions.h \
     ../HriBoardLib/hriboard.h \
     ../HriBoardLib/syncvar.h
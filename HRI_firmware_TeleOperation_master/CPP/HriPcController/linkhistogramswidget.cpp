@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2017 EPFL-LSRO (Laboratoire de Systemes Robotiques).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "linkhistogramswidget.h"
+
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QChartView>
+#include <QBarSeries>
+#include <algorithm>
+
+#define HISTOGRAMS_UPDATE_PERIOD 500 ///< Histograms refresh period [ms].
+#define HISTOGRAM_HEADER_SIZE 2 ///< Lower bound and bucket width, before the counts [word].
+
+static const QStringList HISTOGRAMS_TITLES = { "Round-trip time [us]",
+                                               "Inter-arrival jitter [us]",
+                                               "Frame age [us]" };
+
+/**
+ * @brief Constructor.
+ * The widget stays hidden until a histograms SyncVar is given with
+ * setSyncVar().
+ * @param hriBoard HRI board interface, to read the histograms SyncVar.
+ * @param parent parent of this widget.
+ */
+LinkHistogramsWidget::LinkHistogramsWidget(HriBoard *hriBoard,
+                                           QWidget *parent) :
+    QGroupBox("Link histograms", parent), hriBoard(hriBoard)
+{
+    histogramsVar = nullptr;
+    nBins = 0;
+
+    // Create the charts, side by side, and the reset button below.
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+    QHBoxLayout *chartsLayout = new QHBoxLayout();
+    mainLayout->addLayout(chartsLayout);
+
+    for(QString title : HISTOGRAMS_TITLES)
+    {
+        QtCharts::QChart *chart = new QtCharts::QChart();
+        chart->setTitle(title);
+        chart->legend()->hide();
+
+        QtCharts::QChartView *chartView = new QtCharts::QChartView(chart);
+        chartView->setRenderHint(QPainter::Antialiasing);
+        chartsLayout->addWidget(chartView);
+
+        charts.append(chart);
+    }
+
+    resetButton = new QPushButton("Reset");
+    mainLayout->addWidget(resetButton, 0, Qt::AlignRight);
+    connect(resetButton, SIGNAL(clicked(bool)), this, SLOT(resetCounts()));
+
+    setMinimumHeight(250);
+
+    //
+    updateTimer.setInterval(HISTOGRAMS_UPDATE_PERIOD);
+    updateTimer.setSingleShot(false);
+    connect(&updateTimer, SIGNAL(timeout()), this, SLOT(requestUpdate()));
+
+    connect(hriBoard, SIGNAL(syncVarUpdated(SyncVarBase*)),
+            this, SLOT(onVarUpdated(SyncVarBase*)));
+
+    hide();
+}
+
+/**
+ * @brief Sets the SyncVar to read the histograms from.
+ * @param var the histograms SyncVar, or nullptr if the board does not have
+ * it. In this case, or if the SyncVar is not a UINT32 array with the expected
+ * layout, the widget is hidden.
+ */
+void LinkHistogramsWidget::setSyncVar(SyncVarBase *var)
+{
+    histogramsVar = dynamic_cast<SyncVarArray<uint32_t>*>(var);
+
+    if(histogramsVar != nullptr &&
+       histogramsVar->getLength() % HISTOGRAMS_TITLES.size() == 0 &&
+       histogramsVar->getLength() / HISTOGRAMS_TITLES.size()
+       > HISTOGRAM_HEADER_SIZE)
+    {
+        nBins = histogramsVar->getLength() / HISTOGRAMS_TITLES.size()
+                - HISTOGRAM_HEADER_SIZE;
+        countsOffset.fill(0, histogramsVar->getLength());
+
+        setupCharts();
+        show();
+        updateTimer.start();
+    }
+    else
+    {
+        histogramsVar = nullptr;
+        updateTimer.stop();
+        hide();
+    }
+}
+
+/**
+ * @brief Updates the charts with the new values of the histograms SyncVar.
+ * @param var the SyncVar that was just updated. It is ignored if it is not
+ * the histograms one.
+ */
+void LinkHistogramsWidget::onVarUpdated(SyncVarBase *var)
+{
+    if(histogramsVar == nullptr || var != histogramsVar)
+        return;
+
+    QVector<uint32_t> values = histogramsVar->getLocalValues();
+
+    // If the board was restarted, its counts may be lower than the ones stored
+    // by the last reset.
+    for(int i=0; i<values.size(); i++)
+    {
+        if(values[i] < countsOffset[i])
+        {
+            countsOffset.fill(0);
+            break;
+        }
+    }
+
+    for(int h=0; h<charts.size(); h++)
+    {
+        int first = h * (HISTOGRAM_HEADER_SIZE + nBins);
+        qint32 min = (qint32)values[first];
+        uint32_t binWidth = values[first + 1];
+        uint32_t *counts = &values[first + HISTOGRAM_HEADER_SIZE];
+        uint32_t *offsets = &countsOffset[first + HISTOGRAM_HEADER_SIZE];
+
+        // Label the buckets with their lower bound. The first and the last
+        // ones also count the values out of the range.
+        QStringList labels;
+
+        for(int i=0; i<nBins; i++)
+        {
+            qint64 lowerBound = (qint64)min + (qint64)i * binWidth;
+
+            if(i == 0)
+                labels.append("<" + QString::number(lowerBound + binWidth));
+            else if(i == nBins - 1)
+                labels.append(">=" + QString::number(lowerBound));
+            else
+                labels.append(QString::number(lowerBound));
+        }
+
+        if(binsAxes[h]->categories() != labels)
+        {
+            binsAxes[h]->clear();
+            binsAxes[h]->append(labels);
+        }
+
+        // Display the share of each bucket, since the last reset.
+        double total = 0.0;
+
+        for(int i=0; i<nBins; i++)
+            total += (double)(counts[i] - offsets[i]);
+
+        double maxShare = 0.0;
+
+        for(int i=0; i<nBins; i++)
+        {
+            double share = 0.0;
+
+            if(total > 0.0)
+                share = (double)(counts[i] - offsets[i]) / total * 100.0;
+
+            barSets[h]->replace(i, share);
+            maxShare = std::max(maxShare, share);
+        }
+
+        shareAxes[h]->setRange(0.0, maxShare > 0.0 ? maxShare * 1.05 : 1.0);
+        charts[h]->setTitle(HISTOGRAMS_TITLES[h] + " - "
+                            + QString::number((quint64)total) + " samples");
+    }
+}
+
+/**
+ * @brief Requests the value of the histograms SyncVar to the board.
+ */
+void LinkHistogramsWidget::requestUpdate()
+{
+    if(histogramsVar != nullptr)
+        hriBoard->readRemoteVar(histogramsVar);
+}
+
+/**
+ * @brief Restarts the displayed histograms from the current board counts.
+ */
+void LinkHistogramsWidget::resetCounts()
+{
+    if(histogramsVar != nullptr && histogramsVar->isUpToDate())
+    {
+        countsOffset = histogramsVar->getLocalValues();
+        onVarUpdated(histogramsVar);
+    }
+}
+
+/**
+ * @brief Creates the bar series and the axes of the charts, for nBins buckets.
+ */
+void LinkHistogramsWidget::setupCharts()
+{
+    barSets.clear();
+    binsAxes.clear();
+    shareAxes.clear();
+
+    for(QtCharts::QChart *chart : charts)
+    {
+        chart->removeAllSeries();
+
+        for(QtCharts::QAbstractAxis *axis : chart->axes())
+        {
+            chart->removeAxis(axis);
+            delete axis;
+        }
+
+        QtCharts::QBarSet *barSet = new QtCharts::QBarSet("Share");
+
+        for(int i=0; i<nBins; i++)
+            barSet->append(0.0);
+
+        QtCharts::QBarSeries *series = new QtCharts::QBarSeries();
+        series->setBarWidth(1.0);
+        series->append(barSet);
+        chart->addSeries(series);
+
+        QtCharts::QBarCategoryAxis *binsAxis = new QtCharts::QBarCategoryAxis();
+        chart->addAxis(binsAxis, Qt::AlignBottom);
+        series->attachAxis(binsAxis);
+
+        QtCharts::QValueAxis *shareAxis = new QtCharts::QValueAxis();
+        shareAxis->setTitleText("Share [%]");
+        chart->addAxis(shareAxis, Qt::AlignLeft);
+        series->attachAxis(shareAxis);
+
+        barSets.append(barSet);
+        binsAxes.append(binsAxis);
+        shareAxes.append(shareAxis);
+    }
+}
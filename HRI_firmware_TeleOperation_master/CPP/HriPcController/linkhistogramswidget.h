@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2017 EPFL-LSRO (Laboratoire de Systemes Robotiques).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LINKHISTOGRAMSWIDGET_H
+#define LINKHISTOGRAMSWIDGET_H
+
+#include <QGroupBox>
+#include <QTimer>
+#include <QPushButton>
+#include <QChart>
+#include <QBarSet>
+#include <QBarCategoryAxis>
+#include <QValueAxis>
+
+#include "../HriBoardLib/hriboard.h"
+#include "../HriBoardLib/syncvar.h"
+
+#define LINK_HISTOGRAMS_VAR_NAME "link histograms [us]" ///< Name of the board SyncVar holding the histograms.
+
+/**
+ * @addtogroup HriPcController
+ * @{
+ */
+
+/**
+ * @brief Widget displaying the teleoperation link quality histograms.
+ *
+ * The board shares all the histograms as a single UINT32 array SyncVar. Each
+ * histogram is made of the lower bound of the first bucket (signed), the
+ * bucket width, then the counts. This widget reads this SyncVar periodically,
+ * and plots the distributions as bar charts. Since the board counts are
+ * cumulative, the "Reset" button only stores the current counts, which are
+ * then subtracted from the displayed ones.
+ */
+class LinkHistogramsWidget : public QGroupBox
+{
+    Q_OBJECT
+
+public:
+    LinkHistogramsWidget(HriBoard *hriBoard, QWidget *parent = nullptr);
+    void setSyncVar(SyncVarBase *var);
+
+public slots:
+    void onVarUpdated(SyncVarBase *var);
+    void requestUpdate();
+    void resetCounts();
+
+private:
+    void setupCharts();
+
+    HriBoard *hriBoard; ///< HRI board interface.
+    SyncVarArray<uint32_t> *histogramsVar; ///< Histograms SyncVar, or nullptr if the board does not have it.
+    QVector<uint32_t> countsOffset; ///< Board counts when the "Reset" button was pressed.
+    int nBins; ///< Number of buckets of each histogram.
+
+    QTimer updateTimer; ///< Timer to read the histograms periodically.
+    QPushButton *resetButton; ///< Button to restart the histograms.
+    QList<QtCharts::QChart*> charts;
+    QList<QtCharts::QBarSet*> barSets;
+    QList<QtCharts::QBarCategoryAxis*> binsAxes;
+    QList<QtCharts::QValueAxis*> shareAxes;
+};
+
+/**
+ * @}
+ */
+
+#endif
@@ -32,6 +32,7 @@
 
 #include "../HriBoardLib/hriboard.h"
 #include "../HriBoardLib/syncvar.h"
+#include "linkhistogramswidget.h"
 
 namespace Ui {
 class MainWindow;
@@ -93,6 +94,7 @@ private:
     QList<QtCharts::QLineSeries*> linesSeries;
     QTimer graphUpdateTimer;
     QLinkedList<QList<double>> streamedVarsValuesBuffer;
+    LinkHistogramsWidget *linkHistograms;
 };
 
 /**
@@ -23,20 +23,35 @@ typedef void (*cbt_PeriodicTaskFunc)(void);
 
 // TIMX_PERIOD is the clock divider at the input of the timers.
 // So, the timer will increment its counter, every TIMX_PERIOD ticks of the system clock (168 MHz).
-#define TIM10_PRESCALER ((uint16_t)(SystemCoreClock/APB2_PRESCALER*TIM_MULTIPLIER/1000000-1)) // CLK_CNT = 1[us] (current loop)
-#define TIM6_PRESCALER ((uint16_t)(SystemCoreClock/APB1_PRESCALER*TIM_MULTIPLIER/1000000-1)) // CLK_CNT = 1[us] (control loop)
-#define TIM7_PRESCALER ((uint16_t)(SystemCoreClock/APB1_PRESCALER*TIM_MULTIPLIER/1000000-1)) // CLK_CNT = 1[us] (data loop)
+#define TIM2_PRESCALER ((uint16_t)(SystemCoreClock/APB1_PRESCALER*TIM_MULTIPLIER/1000000-1)) // CLK_CNT = 1[us] (board clock)
 
 /** @defgroup CallbackTimers Driver / Callback timers
   * @brief Driver to call functions at a fixed rate.
   *
-  * This driver setups three timers of the STM32, in order to call at a precise
-  * rate the control functions: the current regulation loop, the position
-  * regulation loop and the communication loop (data streaming part only).
+  * This driver calls at a precise rate the control functions: the current
+  * regulation loop, the position regulation loop and the communication loop
+  * (data streaming part only). A timer runs freely, to provide the board clock
+  * with a microsecond resolution (see cbt_GetMicroseconds()), and the cycle
+  * counter of the core is enabled, to measure the cost of short code sections
+  * (see cbt_GetCycles()).
   *
-  * In the initialization code, first call cbt_Init(). Then call each
-  * cbt_Set*LoopTimer() function, giving the pointer to the function to call as
-  * an argument.
+  * The current loop is called by the update of the PWM timer of the H-bridge
+  * (TIM8), so the current sampling, the regulation and the duty cycle update
+  * are synchronous with the PWM. Its period is rounded to a whole number of
+  * PWM periods, with the repetition counter of TIM8.
+  *
+  * The other loops are phase-locked to the current loop: their periods are
+  * rounded to a whole number of current loop periods, and their interrupts
+  * (TIM6 and TIM7 vectors) are triggered by software. The position loop is
+  * triggered right after the current loop, at a selectable tick of its period
+  * (see cbt_SetHapticControllerPhase()), so it uses a fresh current sample,
+  * and the torque it sets is applied at the next current loop tick. The
+  * communication loop is triggered right after the position loop, when its
+  * period has elapsed, so it does not stream variables being updated.
+  *
+  * In the initialization code, first call cbt_Init(), and hb_Init() before
+  * setting the current loop. Then call each cbt_Set*LoopTimer() function,
+  * giving the pointer to the function to call as an argument.
   *
   * @addtogroup CallbackTimers
   * @{
@@ -46,11 +61,16 @@ void cbt_Init(void);
 void cbt_SetCurrentLoopTimer(cbt_PeriodicTaskFunc f, uint32_t period);
 void cbt_SetHapticControllerTimer(cbt_PeriodicTaskFunc f, uint32_t period);
 void cbt_SetCommLoopTimer(cbt_PeriodicTaskFunc f, uint32_t period);
+void cbt_SetCurrentLoopPeriod(uint32_t period);
 void cbt_SetHapticControllerPeriod(uint32_t period);
+void cbt_SetHapticControllerPhase(uint32_t phase);
 void cbt_SetCommLoopPeriod(uint32_t period);
 uint32_t cbt_GetCurrentLoopPeriod(void);
 uint32_t cbt_GetHapticControllerPeriod(void);
+uint32_t cbt_GetHapticControllerPhase(void);
 uint32_t cbt_GetCommLoopPeriod(void);
+uint32_t cbt_GetMicroseconds(void);
+uint32_t cbt_GetCycles(void);
 
 /**
   * @}
@@ -32,6 +32,11 @@
 
 #define CODER_RESOLUTION ((uint32_t)4096) // Number of increments per turn.
 
+#define ENC_TIMESTAMP_FREQ 12000000 // Frequency of the edge timestamp timer (TIM3), wraps every 5.4 ms [Hz].
+#define ENC_TIMESTAMP_PRESCALER ((uint16_t)(SystemCoreClock/APB1_PRESCALER*TIM_MULTIPLIER/ENC_TIMESTAMP_FREQ-1))
+#define ENC_TIMESTAMP_WRAP_TIME (65536 / (ENC_TIMESTAMP_FREQ / 1000000)) // Period of the timestamp timer [us].
+#define ENC_VELOCITY_TIMEOUT 0.1f // The velocity is zero if no edge is detected during this time [s].
+
 /** @defgroup Encoder Driver / Incremental encoder
   * @brief Driver for an incremental encoder.
   *
@@ -42,12 +47,26 @@
   * The output value is the paddle position in degrees, taking the reduction
   * ratio into account.
   *
+  * The rising edges of the channel A are also timestamped: TIM5 captures its
+  * counter on each edge, and triggers a capture of the free-running TIM3. The
+  * velocity is the number of increments between the last edges of two calls of
+  * enc_GetVelocity(), divided by the exact time between these edges (mixed
+  * M-method and 1/T method). At high speed, many edges occur between the
+  * calls, and the resolution is the one of the timer. At low speed, the edges
+  * are further apart than the calls, and the velocity is bounded by one edge
+  * over the time elapsed since the last one, until it is zero after
+  * ENC_VELOCITY_TIMEOUT. enc_GetVelocity() has to be called periodically from
+  * a single loop, ideally faster than ENC_TIMESTAMP_WRAP_TIME. The other loops
+  * can read its last result with enc_GetLastVelocity().
+  *
   * @addtogroup Encoder
   * @{
   */
 
 void enc_Init(void);
 float32_t enc_GetPosition(void);
+float32_t enc_GetVelocity(void);
+float32_t enc_GetLastVelocity(void);
 void enc_SetPosition(float32_t newPosition);
 
 /**
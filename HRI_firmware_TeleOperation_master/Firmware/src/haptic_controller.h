@@ -29,6 +29,13 @@
   * The content of hapt_Update() is typically what the user of the board will
   * modify, depending on the selected sensors and control algorithms.
   *
+  * The bilateral coupling architecture is selected at runtime with the
+  * "architecture" SyncVar: position-position (symmetric PID), position-force
+  * (master of the torque reflection), force-position (slave following the
+  * master position) or 4-channel. The bimodal, master and slave firmwares are
+  * the same program, which only differ by the architecture and node ID
+  * selected at startup.
+  *
   * Call hapt_Init() to setup this module. Its interrupt function will be called
   * automatically periodically.
   *
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2021 EPFL-REHAssist (Rehabilitation and Assistive Robotics Group).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __BIQUAD_FILTER_H
+#define __BIQUAD_FILTER_H
+
+#include "../main.h"
+
+#define BQF_MAX_ORDER 4 // Max order of a filter.
+#define BQF_MAX_STAGES ((BQF_MAX_ORDER+1)/2) // Max number of biquad stages.
+
+#define BQF_NONE 0 // The signal is not filtered.
+#define BQF_LOW_PASS 1 // Butterworth low-pass filter.
+#define BQF_HIGH_PASS 2 // Butterworth high-pass filter.
+#define BQF_NOTCH 3 // Cascade of identical notch filters, with the quality factor Q.
+#define BQF_N_TYPES 4
+
+/** @defgroup BiquadFilter Lib / Biquad filter
+  * @brief Cascade of biquad filters, with low-pass, high-pass and notch
+  * designs.
+  *
+  * A filter of order N is a cascade of N/2 second-order sections (biquads),
+  * plus a first-order one if N is odd. The low-pass and high-pass filters are
+  * Butterworth. The notch filter of order N is a cascade of (N+1)/2 identical
+  * notches, without first-order section: an odd order is rounded up (orders 1
+  * and 2 give one notch, 3 and 4 two notches). The designs use the bilinear transform, with the cut-off frequency
+  * prewarped.
+  *
+  * The coefficients are computed by bqf_Step() only when the type, the order,
+  * the cut-off frequency, the quality factor or the timestep changed, so they
+  * can be modified at any time (e.g. by the computer through SyncVars). If the
+  * type or the order changes, the filter restarts from a steady state at the
+  * current input. Otherwise, the stages are computed with the transposed direct
+  * form II, with the coefficients stored like for the CMSIS-DSP function
+  * arm_biquad_cascade_df2T_f32(): {b0, b1, b2, -a1, -a2} for each stage.
+  *
+  * First, instantiate a bqf_Filter structure (e.g. "bqf_Filter f;"), then
+  * initialize it once with bqf_Init(). Then, every time a new value of the
+  * signal is received, call bqf_Step(). The filter starts from a steady state
+  * at its first input.
+  *
+  * @ingroup Lib
+  * @addtogroup BiquadFilter
+  * @{
+  */
+
+/**
+  *@brief Biquad cascade filter structure.
+  */
+typedef struct
+{
+    uint8_t type; ///< Type of filter (BQF_NONE, BQF_LOW_PASS, BQF_HIGH_PASS or BQF_NOTCH). Can be modified at any time.
+    uint8_t order; ///< Order of the filter (1 to BQF_MAX_ORDER). Can be modified at any time.
+    float32_t cutoff; ///< Cut-off frequency, or center frequency of the notch [Hz]. Can be modified at any time.
+    float32_t quality; ///< Quality factor of the notch (center frequency over bandwidth). Can be modified at any time.
+
+    // Precomputed coefficients, and the parameters they were computed from.
+    float32_t coefs[5*BQF_MAX_STAGES]; ///< {b0, b1, b2, -a1, -a2} for each stage.
+    uint8_t nStages; ///< Number of stages used.
+    uint8_t coefType, ///< type when the coefficients were computed.
+            coefOrder; ///< order when the coefficients were computed.
+    float32_t coefCutoff, ///< cutoff when the coefficients were computed [Hz].
+              coefQuality, ///< quality when the coefficients were computed.
+              coefDt; ///< Timestep when the coefficients were computed [s].
+
+    // State.
+    float32_t state[2*BQF_MAX_STAGES]; ///< {d1, d2} for each stage.
+    float32_t output; ///< Last computed filtered value.
+} bqf_Filter;
+
+void bqf_Init(bqf_Filter *filter, uint8_t type, uint8_t order,
+              float32_t cutoff, float32_t quality);
+float32_t bqf_Step(bqf_Filter *filter, float32_t input, float32_t dt);
+void bqf_Reset(bqf_Filter *filter, float32_t value);
+
+/**
+  * @}
+  */
+
+#endif
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2021 EPFL-REHAssist (Rehabilitation and Assistive Robotics Group).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __CRC_H
+#define __CRC_H
+
+#include "../main.h"
+
+/** @defgroup CRC Lib / CRC
+  * @brief Cyclic redundancy check, to detect corrupted data.
+  *
+  * This module computes the CRC-16-CCITT (polynomial 0x1021, initial value
+  * 0xFFFF) of a bytes array, using a lookup table.
+  *
+  * Call crc_Crc16() to compute the CRC of a whole array. To compute it
+  * incrementally (e.g. while bytes are received), start from CRC_16_INIT, and
+  * call crc_Crc16Update() for every new byte.
+  *
+  * @ingroup Lib
+  * @addtogroup CRC
+  * @{
+  */
+
+#define CRC_16_INIT 0xFFFF ///< Initial value of the CRC-16-CCITT.
+
+uint16_t crc_Crc16(uint8_t const *data, uint16_t length);
+uint16_t crc_Crc16Update(uint16_t crc, uint8_t newByte);
+
+/**
+  * @}
+  */
+
+#endif
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2021 EPFL-REHAssist (Rehabilitation and Assistive Robotics Group).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "disturbance_observer.h"
+
+/**
+ * @brief Initializes a dob_Observer structure, with a zero estimate.
+ * @param observer the dob_Observer structure to initialize.
+ * @param inertia nominal inertia [N.m/(deg/s^2)].
+ * @param damping nominal viscous damping [N.m/(deg/s)].
+ * @param cutoff cut-off frequency of the observer [Hz].
+ */
+void dob_Init(dob_Observer *observer, float32_t inertia, float32_t damping,
+              float32_t cutoff)
+{
+    observer->inertia = inertia;
+    observer->damping = damping;
+    observer->cutoff = cutoff;
+    observer->filterState = 0.0f;
+    observer->externalTorque = 0.0f;
+}
+
+/**
+ * @brief Updates the estimate of the external torque.
+ * @param observer the disturbance observer.
+ * @param motorTorque the torque applied by the motor, measured from the
+ * current [N.m].
+ * @param velocity the paddle velocity [deg/s].
+ * @param frictionTorque the torque needed to overcome the modelled friction,
+ * in the direction of motion, or 0 if there is no friction model [N.m].
+ * @param dt time elapsed since the last call [s].
+ * @return the estimated external torque [N.m].
+ */
+float32_t dob_Step(dob_Observer *observer, float32_t motorTorque,
+                   float32_t velocity, float32_t frictionTorque, float32_t dt)
+{
+    float32_t omega, velocityTerm, alpha;
+
+    if(observer->cutoff <= 0.0f)
+    {
+        observer->filterState = 0.0f;
+        observer->externalTorque = 0.0f;
+        return 0.0f;
+    }
+
+    omega = 2.0f * (float32_t)M_PI * observer->cutoff; // g [rad/s].
+    velocityTerm = omega * observer->inertia * velocity;
+    alpha = 1.0f - expf(-omega * dt);
+
+    observer->filterState += alpha * (observer->damping * velocity
+                                      + frictionTorque - motorTorque
+                                      - velocityTerm - observer->filterState);
+
+    observer->externalTorque = observer->filterState + velocityTerm;
+
+    return observer->externalTorque;
+}
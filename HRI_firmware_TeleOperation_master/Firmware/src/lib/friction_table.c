@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2021 EPFL-REHAssist (Rehabilitation and Assistive Robotics Group).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "friction_table.h"
+#include "utils.h"
+
+#define FRT_POSITIVE 0 // Index of the positive direction in the calibration arrays.
+#define FRT_NEGATIVE 1 // Index of the negative direction in the calibration arrays.
+
+float32_t frt_Interpolate(const float32_t *torques, float32_t position);
+void frt_FinishCalibration(frt_Table *table);
+void frt_FillTorques(float32_t *torques, const float32_t *torqueSums,
+                     const uint16_t *nSamples);
+
+/**
+ * @brief Initializes a frt_Table structure, with a zero compensation.
+ * @param table the frt_Table structure to initialize.
+ * @param minAngle angle of the first bin of the table [deg].
+ * @param maxAngle angle of the last bin of the table [deg].
+ * @param velocityThreshold velocity under which the two directions are
+ * blended [deg/s].
+ */
+void frt_Init(frt_Table *table, float32_t minAngle, float32_t maxAngle,
+              float32_t velocityThreshold)
+{
+    int i;
+
+    for(i=0; i<FRT_N_BINS; i++)
+    {
+        table->positiveTorques[i] = 0.0f;
+        table->negativeTorques[i] = 0.0f;
+    }
+
+    table->minAngle = minAngle;
+    table->maxAngle = maxAngle;
+    table->gain = 1.0f;
+    table->velocityThreshold = velocityThreshold;
+
+    table->sweepVelocity = 0.0f;
+    table->nSweeps = 0;
+    table->calibrating = false;
+    table->reference = 0.0f;
+    table->direction = 1.0f;
+    table->nReversals = 0;
+}
+
+/**
+ * @brief Computes the friction and cogging compensation torque.
+ * @param table the compensation table.
+ * @param angle the paddle angle [deg].
+ * @param velocity the paddle velocity [deg/s].
+ * @return the compensation torque, interpolated from the table [N.m].
+ */
+float32_t frt_GetTorque(frt_Table *table, float32_t angle, float32_t velocity)
+{
+    float32_t position, positiveWeight;
+
+    if(table->maxAngle <= table->minAngle)
+        return 0.0f;
+
+    // Position in the table, in bins.
+    position = (angle - table->minAngle) / (table->maxAngle - table->minAngle)
+               * (float32_t)(FRT_N_BINS - 1);
+
+    // Weight of the positive direction, 1 when moving fast enough in the
+    // positive direction, 0 in the negative direction, 0.5 at rest.
+    if(table->velocityThreshold > 0.0f)
+    {
+        positiveWeight = velocity / table->velocityThreshold;
+        utils_SaturateF(&positiveWeight, -1.0f, 1.0f);
+        positiveWeight = 0.5f * (1.0f + positiveWeight);
+    }
+    else
+        positiveWeight = (velocity >= 0.0f) ? 1.0f : 0.0f;
+
+    return table->gain
+           * (positiveWeight * frt_Interpolate(table->positiveTorques, position)
+              + (1.0f - positiveWeight)
+                * frt_Interpolate(table->negativeTorques, position));
+}
+
+/**
+ * @brief Interpolates linearly between the bins of a table.
+ * @param torques the torque of each bin [N.m].
+ * @param position the position in the table, saturated to the first and last
+ * bins [bin].
+ * @return the interpolated torque [N.m].
+ */
+float32_t frt_Interpolate(const float32_t *torques, float32_t position)
+{
+    int index;
+    float32_t fraction;
+
+    utils_SaturateF(&position, 0.0f, (float32_t)(FRT_N_BINS - 1));
+
+    index = (int)position;
+
+    if(index >= FRT_N_BINS - 1)
+        return torques[FRT_N_BINS - 1];
+
+    fraction = position - (float32_t)index;
+
+    return torques[index] + fraction * (torques[index+1] - torques[index]);
+}
+
+/**
+ * @brief Starts the calibration of the table, from the current paddle angle.
+ * @param table the compensation table.
+ * @param angle the paddle angle [deg].
+ * @param sweepVelocity velocity of the calibration reference [deg/s].
+ * @param nSweeps number of back and forth sweeps of the angle range.
+ */
+void frt_StartCalibration(frt_Table *table, float32_t angle,
+                          float32_t sweepVelocity, uint8_t nSweeps)
+{
+    int i;
+
+    for(i=0; i<FRT_N_BINS; i++)
+    {
+        table->torqueSums[FRT_POSITIVE][i] = 0.0f;
+        table->torqueSums[FRT_NEGATIVE][i] = 0.0f;
+        table->nSamples[FRT_POSITIVE][i] = 0;
+        table->nSamples[FRT_NEGATIVE][i] = 0;
+    }
+
+    table->sweepVelocity = fabsf(sweepVelocity);
+    table->nSweeps = nSweeps;
+    table->reference = angle;
+    table->direction = 1.0f;
+    table->nReversals = 0;
+    table->calibrating = (table->maxAngle > table->minAngle)
+                         && (table->sweepVelocity > 0.0f) && (nSweeps > 0);
+}
+
+/**
+ * @brief Records the torque applied at the current angle, and moves the
+ * calibration reference. When all the sweeps are done, the table is updated
+ * and the calibrating field is set to false.
+ * @param table the compensation table.
+ * @param angle the paddle angle [deg].
+ * @param velocity the paddle velocity [deg/s].
+ * @param torque the torque applied to the paddle since the last step [N.m].
+ * @param dt time elapsed since the last call [s].
+ * @return the angle the paddle should track [deg].
+ */
+float32_t frt_StepCalibration(frt_Table *table, float32_t angle,
+                              float32_t velocity, float32_t torque,
+                              float32_t dt)
+{
+    float32_t position;
+
+    if(!table->calibrating)
+        return table->reference;
+
+    // Record the torque, only while the paddle moves steadily in the sweep
+    // direction, so the acceleration transients are not included.
+    if(velocity * table->direction
+       > FRT_STEADY_VELOCITY_RATIO * table->sweepVelocity)
+    {
+        position = (angle - table->minAngle)
+                   / (table->maxAngle - table->minAngle)
+                   * (float32_t)(FRT_N_BINS - 1) + 0.5f;
+
+        if(position >= 0.0f && position < (float32_t)FRT_N_BINS)
+        {
+            int direction = (table->direction > 0.0f) ? FRT_POSITIVE
+                                                       : FRT_NEGATIVE;
+            int index = (int)position;
+
+            if(table->nSamples[direction][index] < UINT16_MAX)
+            {
+                table->torqueSums[direction][index] += torque;
+                table->nSamples[direction][index]++;
+            }
+        }
+    }
+
+    // Move the reference, and reverse at the ends of the angle range.
+    table->reference += table->direction * table->sweepVelocity * dt;
+
+    if((table->direction > 0.0f && table->reference >= table->maxAngle) ||
+       (table->direction < 0.0f && table->reference <= table->minAngle))
+    {
+        utils_SaturateF(&table->reference, table->minAngle, table->maxAngle);
+        table->direction = -table->direction;
+        table->nReversals++;
+
+        if(table->nReversals > 2 * table->nSweeps)
+            frt_FinishCalibration(table);
+    }
+
+    return table->reference;
+}
+
+/**
+ * @brief Stops the calibration, without modifying the table.
+ * @param table the compensation table.
+ */
+void frt_AbortCalibration(frt_Table *table)
+{
+    table->calibrating = false;
+}
+
+/**
+ * @brief Computes the table from the recorded torques, and stops the
+ * calibration.
+ * @param table the compensation table.
+ */
+void frt_FinishCalibration(frt_Table *table)
+{
+    frt_FillTorques(table->positiveTorques, table->torqueSums[FRT_POSITIVE],
+                    table->nSamples[FRT_POSITIVE]);
+    frt_FillTorques(table->negativeTorques, table->torqueSums[FRT_NEGATIVE],
+                    table->nSamples[FRT_NEGATIVE]);
+
+    table->calibrating = false;
+}
+
+/**
+ * @brief Averages the recorded torques of each bin, and fills the bins without
+ * samples with the nearest bin that has some. If no bin has samples, the
+ * torques are not modified.
+ * @param torques the torques of the table, for one direction [N.m].
+ * @param torqueSums the sum of the recorded torques of each bin [N.m].
+ * @param nSamples the number of recorded torques of each bin.
+ */
+void frt_FillTorques(float32_t *torques, const float32_t *torqueSums,
+                     const uint16_t *nSamples)
+{
+    int i, nearest;
+
+    for(i=0; i<FRT_N_BINS; i++)
+    {
+        int distance;
+
+        nearest = -1;
+
+        for(distance=0; distance<FRT_N_BINS && nearest < 0; distance++)
+        {
+            if(i - distance >= 0 && nSamples[i - distance] > 0)
+                nearest = i - distance;
+            else if(i + distance < FRT_N_BINS && nSamples[i + distance] > 0)
+                nearest = i + distance;
+        }
+
+        if(nearest < 0)
+            return; // No samples at all.
+
+        torques[i] = torqueSums[nearest] / (float32_t)nSamples[nearest];
+    }
+}
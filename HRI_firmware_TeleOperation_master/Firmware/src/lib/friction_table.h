@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2021 EPFL-REHAssist (Rehabilitation and Assistive Robotics Group).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __FRICTION_TABLE_H
+#define __FRICTION_TABLE_H
+
+#include "../main.h"
+
+/** @defgroup FrictionTable Lib / Friction table
+  * @brief Compensation of the friction and cogging of the geared motor, with
+  * an angle-indexed lookup table, identified by a calibration sweep.
+  *
+  * The table stores the torque needed to move the paddle, for FRT_N_BINS
+  * angles evenly spread between minAngle and maxAngle, and for each direction
+  * of motion. The compensation torque is interpolated linearly between the
+  * bins, and blended between the two directions when the velocity is lower
+  * than velocityThreshold, so it does not chatter at rest.
+  *
+  * During the calibration, the paddle tracks a reference that sweeps the angle
+  * range back and forth at sweepVelocity, nSweeps times. The torque applied
+  * while the paddle moves steadily in the sweep direction is averaged in each
+  * bin, and the bins that were not reached are filled with their nearest
+  * neighbour.
+  *
+  * Create a frt_Table structure, and initialize it with frt_Init(). Call
+  * frt_GetTorque() at every control tick to get the compensation torque. To
+  * calibrate the table, call frt_StartCalibration(), then
+  * frt_StepCalibration() at every control tick, and make the paddle track the
+  * reference it returns, until the calibrating field goes back to false.
+  *
+  * @ingroup Lib
+  * @addtogroup FrictionTable
+  * @{
+  */
+
+#define FRT_N_BINS 32 ///< Number of angles of the table, for each direction (128 bytes, a writable SyncVar holds up to 255).
+#define FRT_STEADY_VELOCITY_RATIO 0.5f ///< Min velocity to record a sample, relative to the sweep velocity.
+
+/**
+ * @brief Friction and cogging compensation table.
+ */
+typedef struct
+{
+    float32_t positiveTorques[FRT_N_BINS]; ///< Torque needed to move in the positive direction, for each angle [N.m].
+    float32_t negativeTorques[FRT_N_BINS]; ///< Torque needed to move in the negative direction, for each angle [N.m].
+    float32_t minAngle; ///< Angle of the first bin [deg].
+    float32_t maxAngle; ///< Angle of the last bin [deg].
+    float32_t gain; ///< Gain of the compensation torque, 0 to disable [].
+    float32_t velocityThreshold; ///< Velocity under which the two directions are blended [deg/s].
+
+    float32_t sweepVelocity; ///< Velocity of the calibration reference [deg/s].
+    uint8_t nSweeps; ///< Number of back and forth calibration sweeps.
+    bool calibrating; ///< true while the calibration is in progress.
+    float32_t reference; ///< Angle the paddle tracks during the calibration [deg].
+    float32_t direction; ///< Direction of the calibration sweep, +1 or -1.
+    uint16_t nReversals; ///< Number of direction changes since the start of the calibration, up to 2*nSweeps+1.
+    float32_t torqueSums[2][FRT_N_BINS]; ///< Sum of the recorded torques, for each direction and angle [N.m].
+    uint16_t nSamples[2][FRT_N_BINS]; ///< Number of recorded torques, for each direction and angle.
+} frt_Table;
+
+void frt_Init(frt_Table *table, float32_t minAngle, float32_t maxAngle,
+              float32_t velocityThreshold);
+float32_t frt_GetTorque(frt_Table *table, float32_t angle, float32_t velocity);
+void frt_StartCalibration(frt_Table *table, float32_t angle,
+                          float32_t sweepVelocity, uint8_t nSweeps);
+float32_t frt_StepCalibration(frt_Table *table, float32_t angle,
+                              float32_t velocity, float32_t torque,
+                              float32_t dt);
+void frt_AbortCalibration(frt_Table *table);
+
+/**
+  * @}
+  */
+
+#endif
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2021 EPFL-REHAssist (Rehabilitation and Assistive Robotics Group).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HAPTIC_EFFECTS_H
+#define __HAPTIC_EFFECTS_H
+
+#include "../main.h"
+
+/** @defgroup HapticEffects Lib / Haptic effects
+  * @brief Engine rendering a set of haptic effects, to build virtual
+  * environments at runtime.
+  *
+  * The engine holds up to HFX_MAX_EFFECTS effects. Each slot has a type and
+  * a few parameters, whose meaning depends on the type:
+  * - HFX_WALL_MIN, HFX_WALL_MAX: unilateral spring and damper, that pushes the
+  *   paddle back above (resp. below) position. The damping only acts while
+  *   the paddle moves into the wall.
+  * - HFX_SPRING: spring and damper centered on position.
+  * - HFX_DAMPER: viscous damping.
+  * - HFX_DETENT: sinusoidal torque of amplitude maxTorque, with stable
+  *   positions every width degrees from position, plus damping.
+  * - HFX_TABLE: torque interpolated from the table of the engine, between
+  *   position and position+width, plus damping. It is zero outside of this
+  *   range.
+  * The torque of each effect is saturated to its maxTorque, if positive.
+  *
+  * The parameters are stored as arrays, one element per slot, so they can be
+  * shared directly with the computer: writing a type in a free slot adds an
+  * effect, and writing HFX_NONE removes it. The parameters of a slot should be
+  * written before its type, so the effect is complete when it becomes active.
+  *
+  * Create a hfx_Engine structure, and initialize it with hfx_Init(). Then,
+  * call hfx_Step() at every control tick, to get the sum of the torques of
+  * the active effects.
+  *
+  * @ingroup Lib
+  * @addtogroup HapticEffects
+  * @{
+  */
+
+#define HFX_MAX_EFFECTS 8 ///< Max number of effects of an engine.
+#define HFX_TABLE_SIZE 32 ///< Number of points of the table of the HFX_TABLE effects (128 bytes, a writable SyncVar holds up to 255).
+
+#define HFX_NONE 0 ///< Free slot.
+#define HFX_WALL_MIN 1 ///< Wall blocking the angles lower than position.
+#define HFX_WALL_MAX 2 ///< Wall blocking the angles higher than position.
+#define HFX_SPRING 3 ///< Spring centered on position.
+#define HFX_DAMPER 4 ///< Viscous damping.
+#define HFX_DETENT 5 ///< Periodic detents.
+#define HFX_TABLE 6 ///< Angle-indexed torque table.
+#define HFX_N_TYPES 7
+
+/**
+ * @brief Haptic effects engine.
+ */
+typedef struct
+{
+    uint8_t types[HFX_MAX_EFFECTS]; ///< Type of each effect, HFX_NONE for a free slot.
+    float32_t positions[HFX_MAX_EFFECTS]; ///< Angle of the wall, center of the spring, stable angle of a detent or start of the table [deg].
+    float32_t stiffnesses[HFX_MAX_EFFECTS]; ///< Stiffness of the wall or spring [N.m/deg].
+    float32_t dampings[HFX_MAX_EFFECTS]; ///< Viscous damping [N.m/(deg/s)].
+    float32_t widths[HFX_MAX_EFFECTS]; ///< Spacing of the detents, or angle range of the table [deg].
+    float32_t maxTorques[HFX_MAX_EFFECTS]; ///< Saturation of the effect torque, 0 to disable, or amplitude of the detents [N.m].
+    float32_t table[HFX_TABLE_SIZE]; ///< Torques of the HFX_TABLE effects, evenly spread over their angle range [N.m].
+    uint8_t nActiveEffects; ///< Number of effects evaluated at the last step.
+} hfx_Engine;
+
+void hfx_Init(hfx_Engine *engine);
+float32_t hfx_Step(hfx_Engine *engine, float32_t angle, float32_t velocity);
+
+/**
+  * @}
+  */
+
+#endif
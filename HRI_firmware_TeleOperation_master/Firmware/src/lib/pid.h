@@ -27,6 +27,19 @@
   * initialize it once with pid_Init(). Then, every time a new command needs to
   * be computed (typically when a new measurement arrives), call pid_Step().
   *
+  * For a loop with a fixed period, the pid_DiscretePid regulator precomputes
+  * its coefficients, and recomputes them only when the gains or the timestep
+  * change. Its derivative acts on the measurement (optionally on a fraction of
+  * the target), and is low-pass filtered, so target steps do not kick the
+  * command. The command is saturated, and the integrator is frozen while the
+  * command saturates (clamping anti-windup). The integral and derivative
+  * states are stored as command contributions, and the integrator absorbs the
+  * change of the proportional part when kp changes, so the gains can be
+  * modified at any time without a bump. Initialize it with
+  * pid_InitDiscrete(), then call pid_StepDiscrete() at every loop tick, and
+  * pid_ResetDiscrete() when the regulator is not used, to track the
+  * measurement.
+  *
   * @addtogroup PID
   * @{
   */
@@ -48,10 +61,49 @@ typedef struct
               feedforward; ///< Feedforward coefficient.
 } pid_Pid;
 
+/**
+  *@brief Discrete PID regulator structure, with precomputed coefficients.
+  */
+typedef struct
+{
+    float32_t kp, ///< Proportional gain. Can be modified at any time.
+              ki, ///< Integral gain [1/s]. Can be modified at any time.
+              kd, ///< Derivative gain [s]. Can be modified at any time.
+              derivativeCutoff, ///< Cut-off frequency of the derivative low-pass filter, 0 to disable [Hz].
+              derivativeTargetWeight, ///< Fraction of the target in the derivative input: 0 for the measurement only, 1 for the error.
+              commandMin, ///< Min value of the command.
+              commandMax, ///< Max value of the command.
+              command; ///< Output command computed by the PID regulator.
+
+    // Precomputed coefficients, and the parameters they were computed from.
+    float32_t integralCoef, ///< ki*dt.
+              derivativeFilterCoef, ///< Pole of the discrete derivative filter, tau/(tau+dt).
+              derivativeCoef, ///< kd/(tau+dt).
+              coefKp, ///< kp when the coefficients were computed.
+              coefKi, ///< ki when the coefficients were computed.
+              coefKd, ///< kd when the coefficients were computed.
+              coefCutoff, ///< derivativeCutoff when the coefficients were computed [Hz].
+              coefDt; ///< Timestep when the coefficients were computed [s].
+
+    // State.
+    float32_t integrator, ///< Integral part of the command.
+              derivative, ///< Filtered derivative part of the command.
+              previousDerivativeInput, ///< Derivative input at the previous step.
+              previousError; ///< Error (target-measurement) at the previous step.
+} pid_DiscretePid;
+
 void pid_Init(pid_Pid *pid, float32_t kp, float32_t ki, float32_t kd,
               float32_t arw, float32_t feedforward);
 float32_t pid_Step(pid_Pid *pid, float32_t current, float32_t target, float32_t dt);
 
+void pid_InitDiscrete(pid_DiscretePid *pid, float32_t kp, float32_t ki,
+                      float32_t kd, float32_t derivativeCutoff,
+                      float32_t commandMin, float32_t commandMax);
+float32_t pid_StepDiscrete(pid_DiscretePid *pid, float32_t measurement,
+                           float32_t target, float32_t dt);
+void pid_ResetDiscrete(pid_DiscretePid *pid, float32_t measurement,
+                       float32_t target);
+
 /**
   * @}
   */
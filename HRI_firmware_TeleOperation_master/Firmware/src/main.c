@@ -43,6 +43,8 @@ int main(void)
     //
     cbt_Init(); // Set up the timers that will call the loops functions.
     
+    hb_Init();   // Set up the H-bridge, whose PWM timer also times the current loop.
+
 	adc_Init(); // Set up the ADC.
 	
 	comm_Init(); // Set up the communication module.
@@ -53,7 +55,6 @@ int main(void)
 	
     enc_Init(); // Set up the incremental encoders.
     
-    hb_Init();   // Set up the H-bridge.
     hb_Enable(); //
     
     dac_Init(); // Set up the DAC.
@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2021 EPFL-REHAssist (Rehabilitation and Assistive Robotics Group).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __TELEOP_LINK_H
+#define __TELEOP_LINK_H
+
+#include "main.h"
+#include "lib/histogram.h"
+#include "drivers/ext_uart.h"
+
+/** @defgroup TeleopLink Main / Teleoperation link
+  * @brief Exchanges the state of the paddle with the other boards of the ring.
+  *
+  * The state of a paddle is made of several channels: position, velocity,
+  * commanded torque and measured current. The sender selects the channels to
+  * send with a bitmask of TLINK_POSITION, TLINK_VELOCITY, TLINK_TORQUE and
+  * TLINK_CURRENT, so the same firmware can run position-position,
+  * position-force or 4-channel architectures. For the wave variables
+  * architecture, the TLINK_WAVE channel carries the wave sent to the
+  * neighbour (see WaveVariables). The TLINK_ENERGY channel carries the energy
+  * that entered the coupling through the sender port, for the passivity
+  * observer (see Passivity). The timestamp of the sender is
+  * always transmitted, since it is part of the ext_uart frame header.
+  *
+  * The state is sent to all the other nodes of the ring (see EXT_UART), and
+  * the last state received from each node is kept separately, so each board
+  * can choose which nodes it is coupled to.
+  *
+  * The clocks of the boards are synchronized NTP-style: every
+  * TLINK_SYNC_PERIOD frames, the sender echoes the timestamp of the last frame
+  * it received from one of the other nodes, in turn, and how long it held it
+  * before replying. From these, this node estimates the round-trip time, the
+  * one-way delay, and the offset and drift of the clock of each node (see
+  * tlink_ClockSync). Around the ring, a frame takes hops+1 links to come from a
+  * node, and the reply takes the other links, so the one-way delay from the
+  * node is assumed to be the round-trip time times (hops+1)/nNodes, which is
+  * half of it with two nodes.
+  *
+  * To monitor the link quality, histograms of the round-trip time, of the
+  * inter-arrival jitter of the frames, and of the age of the neighbour state
+  * when it is used are updated at every tick (see tlink_Histograms). They are
+  * cumulative, so the computer can compute the distribution over any duration
+  * by subtracting two readings.
+  *
+  * To fit the UART link budget, each channel is sent as a scaled 16-bit
+  * integer. A frame with the 4 channels takes 11 (header and CRC) + 1
+  * (channels bitmask) + 4*2 = 20 bytes, and the 7 bytes of the clock
+  * synchronization fields add 0.875 byte per frame on average. The wave
+  * channel adds 2 bytes, and the energy channel 4 bytes, since it is a 32-bit
+  * counter that wraps around (see TLINK_ENERGY_SCALE). At 2 Mbaud and with a
+  * 350 us haptic loop, each node can send 23 bytes per tick in a ring of 4
+  * nodes: the 4 channels, plus the wave or 2 bytes to spare. With 2 or 3
+  * nodes (70 or 35 bytes per node), all the channels fit. In a ring of 4
+  * nodes, the 4 channels with the energy do not: tlink_GetFrameBudget() gives
+  * the budget at the current tick and ring size, so the caller can drop the
+  * channels it can spare, and the frames sent over budget are counted (see
+  * tlink_GetBudgetOverflows()).
+  *
+  * Call tlink_Init() after exuart_Init(). Then, call tlink_SendState() once per
+  * haptic loop tick, and tlink_GetState() to update the state of each coupled
+  * node with the last frame received from it. tlink_GetState() should be
+  * called once per tick, even if no frame is expected, since it also records
+  * the frame age.
+  *
+  * @addtogroup TeleopLink
+  * @{
+  */
+
+#define TLINK_POSITION 0x01 ///< Paddle position channel bit.
+#define TLINK_VELOCITY 0x02 ///< Paddle velocity channel bit.
+#define TLINK_TORQUE   0x04 ///< Commanded motor torque channel bit.
+#define TLINK_CURRENT  0x08 ///< Measured motor current channel bit.
+#define TLINK_WAVE     0x10 ///< Wave variable channel bit.
+#define TLINK_ENERGY   0x20 ///< Passivity observer input energy channel bit.
+#define TLINK_ALL_CHANNELS (TLINK_POSITION | TLINK_VELOCITY | TLINK_TORQUE | TLINK_CURRENT) ///< 4-channel architecture.
+#define TLINK_CHANNELS_MASK (TLINK_ALL_CHANNELS | TLINK_WAVE | TLINK_ENERGY) ///< All the channels that can be sent.
+#define TLINK_SYNC     0x80 ///< Flag set when the clock synchronization fields are present.
+
+#define TLINK_MAX_NODES EXUART_MAX_NODES ///< Max number of boards exchanging their state.
+
+#define TLINK_SYNC_PERIOD 8 ///< Number of frames between two clock synchronization fields.
+#define TLINK_SYNC_FILTER_GAIN 0.1f ///< Gain of the first-order filters of the clock estimates [].
+#define TLINK_DRIFT_WINDOW 1000000 ///< Min duration between two clock drift measurements [us].
+
+#define TLINK_RTT_HIST_MIN 0 ///< Lower bound of the round-trip time histogram [us].
+#define TLINK_RTT_HIST_BIN_WIDTH 100 ///< Bucket width of the round-trip time histogram [us].
+#define TLINK_JITTER_HIST_MIN (-450) ///< Lower bound of the inter-arrival jitter histogram [us].
+#define TLINK_JITTER_HIST_BIN_WIDTH 50 ///< Bucket width of the inter-arrival jitter histogram [us].
+#define TLINK_AGE_HIST_MIN 0 ///< Lower bound of the frame age histogram [us].
+#define TLINK_AGE_HIST_BIN_WIDTH 100 ///< Bucket width of the frame age histogram [us].
+
+#define TLINK_POSITION_SCALE 100.0f ///< Resolution of 0.01 deg, range of +-327 deg [LSB/deg].
+#define TLINK_VELOCITY_SCALE 10.0f ///< Resolution of 0.1 deg/s, range of +-3276 deg/s [LSB/(deg/s)].
+#define TLINK_TORQUE_SCALE 100000.0f ///< Resolution of 0.01 mN.m, range of +-0.327 N.m [LSB/(N.m)].
+#define TLINK_CURRENT_SCALE 1000.0f ///< Resolution of 1 mA, range of +-32.7 A [LSB/A].
+#define TLINK_WAVE_SCALE 1000.0f ///< Resolution of 0.001, range of +-32.7 [LSB/sqrt(N.m.deg/s)].
+#define TLINK_ENERGY_SCALE 1000000.0 ///< Resolution of 1 uN.m.deg, wraps around every 4295 N.m.deg [LSB/(N.m.deg)].
+
+/**
+ * @brief State of a paddle, exchanged between the boards.
+ */
+typedef struct
+{
+    uint32_t timestamp; ///< Sender timestamp, when the state was sent [us].
+    uint8_t channels; ///< Bitmask of the channels received in the last frame.
+    float32_t position; ///< Paddle position [deg].
+    float32_t velocity; ///< Paddle velocity [deg/s].
+    float32_t torque; ///< Commanded motor torque [N.m].
+    float32_t current; ///< Measured motor current [A].
+    float32_t wave; ///< Wave variable [sqrt(N.m.deg/s)].
+    double energy; ///< Energy that entered the coupling through the sender port, unwrapped by the receiver [N.m.deg].
+} tlink_State;
+
+/**
+ * @brief Estimates of the clock of another node, relative to the local board
+ * clock.
+ */
+typedef struct
+{
+    int32_t offset; ///< Node clock minus local clock [us].
+    uint32_t roundTripTime; ///< Time for a frame to go to the node and back, excluding the node hold time [us].
+    uint32_t oneWayDelay; ///< Transmission delay of a frame from the node, estimated from roundTripTime and the number of hops [us].
+    float32_t drift; ///< Node clock rate minus local clock rate [ppm].
+    uint32_t nExchanges; ///< Number of timestamps exchanges processed.
+} tlink_ClockSync;
+
+/**
+ * @brief Link quality histograms.
+ * The structure is made of 32-bit words only, so it can be shared with the
+ * computer as a single UINT32 array SyncVar.
+ */
+typedef struct
+{
+    hist_Histogram roundTripTime; ///< Round-trip time of each timestamps exchange, before filtering [us].
+    hist_Histogram interArrivalJitter; ///< Reception interval minus sending interval of two consecutive frames of a node [us].
+    hist_Histogram frameAge; ///< Age of the node state at each tlink_GetState() call, in the local clock [us].
+} tlink_Histograms;
+
+void tlink_Init(void);
+void tlink_SendState(tlink_State const *state, uint8_t channels);
+uint8_t tlink_GetFrameSize(uint8_t channels);
+uint32_t tlink_GetFrameBudget(void);
+uint32_t tlink_GetBudgetOverflows(void);
+bool tlink_GetState(uint8_t node, tlink_State *state);
+volatile tlink_ClockSync *tlink_GetClockSync(uint8_t node);
+uint32_t tlink_GetNodeTime(uint8_t node, uint32_t localTime);
+volatile tlink_Histograms *tlink_GetHistograms(void);
+
+/**
+  * @}
+  */
+
+#endif
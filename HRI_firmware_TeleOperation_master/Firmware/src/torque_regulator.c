@@ -22,7 +22,6 @@
 #include "drivers/hall.h"
 #include "drivers/h_bridge.h"
 #include "drivers/callback_timers.h"
-#include "lib/basic_filter.h"
 #include "lib/pid.h"
 #include "lib/utils.h"
 #include "torque_regulator.h"
@@ -31,29 +30,89 @@
 #define KI_CURRENT_DEFAULT_VAL 10000.0f // [V/(A.s)].
 #define KD_CURRENT_DEFAULT_VAL 0.0f // [V/(A/s)].
 #define FF_CURRENT_DEFAULT_VAL MOTOR_RESISTANCE // [V/A].
+#define BACK_EMF_CONST_DEFAULT_VAL (60.0f / (360.0f * MOTOR_SPEED_CONST)) // Inverse of the speed constant [V/(deg/s)].
 #define CURRENT_INTEGRATOR_SAT_DEFAULT_VAL 24.0f // [V].
 #define CURRENT_LOOP_PWM_MAX_DUTY_CYCLE 0.98f // Max PWM value (normalized) duty cycle (less than 1 to ensure bootstrap capacitor charging).
 
 #define CURRENT_LOOP_PERIOD 50 // Current control loop period [us].
 
+#define AUTOTUNE_RELAY_VOLTAGE_DEFAULT_VAL 2.0f // Relay voltage of the current loop auto-tuning [V].
+#define AUTOTUNE_HYSTERESIS_DEFAULT_VAL 0.02f // Half-width of the relay hysteresis band [A].
+#define AUTOTUNE_DURATION_DEFAULT_VAL 0.5f // Duration of the relay experiment [s].
+#define AUTOTUNE_BANDWIDTH_DEFAULT_VAL 250.0f // Closed-loop bandwidth of the tuned current loop [Hz].
+
+#define PEAK_TORQUE_DEFAULT_VAL (3.0f * MOTOR_NOMINAL_TORQUE) // Torque limit while the winding is cold [N.m].
+#define DERATING_TEMPERATURE_DEFAULT_VAL 100.0f // Winding temperature from which the peak torque is derated [degC].
+#define RESISTANCE_REF_TEMPERATURE 25.0f // Temperature of the MOTOR_RESISTANCE value [degC].
+#define COPPER_TEMPERATURE_COEF 0.00393f // Relative increase of the copper resistance per degree [1/K].
+#define THERMAL_MODEL_DECIMATION 20 // Number of current loop ticks between two updates of the thermal model.
+
 #define SOFTER_PID_DURATION 0.005f // Short time when softer PID settings are used, in case a H-bridge fault is detected [s].
 
 volatile float32_t torq_targetCurrent; // Target current [A].
 volatile pid_Pid torq_currentPid;
 volatile float32_t motorVoltage;
+volatile bool torq_backEmfCompensation = false; // true to feed the back-EMF forward, from the encoder velocity.
+volatile float32_t torq_backEmfConst = BACK_EMF_CONST_DEFAULT_VAL; // Back-EMF per motor shaft velocity [V/(deg/s)].
+volatile float32_t torq_backEmfVoltage; // Back-EMF voltage fed forward [V].
+float32_t torq_nominalKp, torq_nominalKi; // Gains of the current PID, outside of the "softer PID" mode.
+
+volatile uint8_t torq_autotuneState = TORQ_AUTOTUNE_IDLE; // One of the TORQ_AUTOTUNE_ values.
+volatile float32_t torq_autotuneRelayVoltage = AUTOTUNE_RELAY_VOLTAGE_DEFAULT_VAL; // [V].
+volatile float32_t torq_autotuneHysteresis = AUTOTUNE_HYSTERESIS_DEFAULT_VAL; // [A].
+volatile float32_t torq_autotuneDuration = AUTOTUNE_DURATION_DEFAULT_VAL; // [s].
+volatile float32_t torq_autotuneBandwidth = AUTOTUNE_BANDWIDTH_DEFAULT_VAL; // [Hz].
+volatile float32_t torq_autotuneProgress; // Progress of the relay experiment [%].
+volatile float32_t torq_identifiedResistance; // Motor resistance identified by the auto-tuning [ohm].
+volatile float32_t torq_identifiedInductance; // Motor inductance identified by the auto-tuning [H].
+float32_t torq_autotuneTime; // Time elapsed since the start of the relay experiment [s].
+uint32_t torq_autotuneTicks; // Number of ticks since the start of the relay experiment.
+float32_t torq_autotuneRelaySign; // Sign of the relay voltage, +1 or -1.
+float32_t torq_autotuneVoltages[2]; // Voltages computed at the last two ticks [V].
+float32_t torq_autotunePrevCurrent; // Current measured at the previous tick [A].
+float32_t torq_autotuneSums[5]; // Least squares sums: i.i, i.di, di.di, i.v, di.v.
+
+volatile float32_t torq_windingTemperature; // Winding temperature estimated by the thermal model [degC].
+volatile float32_t torq_torqueLimit; // Max torque allowed by the thermal model [N.m].
+volatile float32_t torq_peakTorque = PEAK_TORQUE_DEFAULT_VAL; // [N.m].
+volatile float32_t torq_deratingTemperature = DERATING_TEMPERATURE_DEFAULT_VAL; // [degC].
+volatile float32_t torq_maxWindingTemperature = MOTOR_MAX_WINDING_TEMPERATURE; // [degC].
+volatile float32_t torq_ambientTemperature = AMBIENT_TEMPERATURE; // [degC].
+volatile float32_t torq_thermalResistance = MOTOR_THERMAL_RESISTANCE; // [K/W].
+volatile float32_t torq_thermalTimeConst = MOTOR_THERMAL_TIME_CONST; // [s].
+float32_t torq_heatEnergy; // Heat dissipated in the winding since the last update of the thermal model [J].
+float32_t torq_heatTime; // Time since the last update of the thermal model [s].
+uint32_t torq_thermalTicks; // Current loop ticks since the last update of the thermal model.
 
 bool torq_regulateCurrent;
 float32_t torq_pidSoftModeTime; // Remaining time for the "softer PID settings" mode [s].
 
 void torq_RegulateCurrent(void);
+void torq_StartAutotune(void);
+float32_t torq_AutotuneStep(float32_t current, float32_t dt);
+void torq_FinishAutotune(void);
+void torq_UpdateThermalModel(float32_t current, float32_t dt);
 
 /**
   * @brief Initialize the position and current controllers.
   */
 void torq_Init(void)
 {
+    bqf_Filter *currentFilter = adc_GetCurrentFilter();
+
     torq_targetCurrent = 0.0f;
     torq_pidSoftModeTime = 0.0f;
+    torq_backEmfVoltage = 0.0f;
+    torq_nominalKp = KP_CURRENT_DEFAULT_VAL;
+    torq_nominalKi = KI_CURRENT_DEFAULT_VAL;
+    torq_autotuneProgress = 0.0f;
+    torq_identifiedResistance = 0.0f;
+    torq_identifiedInductance = 0.0f;
+    torq_windingTemperature = torq_ambientTemperature;
+    torq_torqueLimit = torq_peakTorque;
+    torq_heatEnergy = 0.0f;
+    torq_heatTime = 0.0f;
+    torq_thermalTicks = 0;
     
     // By default the current regulator is off, to allow the calibration of the
     // current sensor.
@@ -70,12 +129,38 @@ void torq_Init(void)
     // Share some variables with the computer.
     comm_monitorFloat("actual_current [A]", (float32_t*)&torq_currentPid.current, READONLY);
     comm_monitorFloat("target_current [A]", (float32_t*)&torq_currentPid.target, READONLY);
+    comm_monitorBoolFunc("current sync sampling", adc_GetSynchronousSampling,
+                         adc_SetSynchronousSampling);
+    comm_monitorUint8("current filter type", &currentFilter->type, READWRITE);
+    comm_monitorUint8("current filter order", &currentFilter->order, READWRITE);
+    comm_monitorFloat("current filter cutoff [Hz]", &currentFilter->cutoff, READWRITE);
+    comm_monitorFloat("current filter Q", &currentFilter->quality, READWRITE);
+    comm_monitorFloat("resistance feedforward [V/A]", (float32_t*)&torq_currentPid.feedforward, READWRITE);
+    comm_monitorBool("enable back-EMF feedforward", (bool*)&torq_backEmfCompensation, READWRITE);
+    comm_monitorFloat("back-EMF const [V/(deg/s)]", (float32_t*)&torq_backEmfConst, READWRITE);
+    comm_monitorFloat("back-EMF voltage [V]", (float32_t*)&torq_backEmfVoltage, READONLY);
+    comm_monitorFloatFunc("CL_Kp", torq_GetCurrentLoopKp, torq_SetCurrentLoopKp);
+    comm_monitorFloatFunc("CL_Ki", torq_GetCurrentLoopKi, torq_SetCurrentLoopKi);
+    comm_monitorUint8("current autotune", (uint8_t*)&torq_autotuneState, READWRITE);
+    comm_monitorFloat("autotune relay voltage [V]", (float32_t*)&torq_autotuneRelayVoltage, READWRITE);
+    comm_monitorFloat("autotune hysteresis [A]", (float32_t*)&torq_autotuneHysteresis, READWRITE);
+    comm_monitorFloat("autotune duration [s]", (float32_t*)&torq_autotuneDuration, READWRITE);
+    comm_monitorFloat("autotune bandwidth [Hz]", (float32_t*)&torq_autotuneBandwidth, READWRITE);
+    comm_monitorFloat("autotune progress [%]", (float32_t*)&torq_autotuneProgress, READONLY);
+    comm_monitorFloat("identified resistance [ohm]", (float32_t*)&torq_identifiedResistance, READONLY);
+    comm_monitorFloat("identified inductance [H]", (float32_t*)&torq_identifiedInductance, READONLY);
+    comm_monitorFloat("winding temperature [degC]", (float32_t*)&torq_windingTemperature, READONLY);
+    comm_monitorFloat("torque limit [N.m]", (float32_t*)&torq_torqueLimit, READONLY);
+    comm_monitorFloat("peak torque [N.m]", (float32_t*)&torq_peakTorque, READWRITE);
+    comm_monitorFloat("derating temperature [degC]", (float32_t*)&torq_deratingTemperature, READWRITE);
+    comm_monitorFloat("max winding temperature [degC]", (float32_t*)&torq_maxWindingTemperature, READWRITE);
+    comm_monitorFloat("ambient temperature [degC]", (float32_t*)&torq_ambientTemperature, READWRITE);
+    comm_monitorFloat("thermal resistance [K/W]", (float32_t*)&torq_thermalResistance, READWRITE);
+    comm_monitorFloat("thermal time constant [s]", (float32_t*)&torq_thermalTimeConst, READWRITE);
 
     // Uncomment these variables for current PID tuning of the motor
     /*comm_monitorFloat("CL_V_cmd [v]", (float32_t*)&motorVoltage, READONLY);
-    comm_monitorFloatFunc("CL_Kp", torq_GetCurrentLoopKp, torq_SetCurrentLoopKp);
     comm_monitorFloatFunc("CL_Kd", torq_GetCurrentLoopKd, torq_SetCurrentLoopKd);
-    comm_monitorFloatFunc("CL_Ki", torq_GetCurrentLoopKi, torq_SetCurrentLoopKi);
     comm_monitorFloatFunc("CL_ARW", torq_GetCurrentLoopARW, torq_SetCurrentLoopARW);*/
 }
 
@@ -103,14 +188,17 @@ void torq_RegulateCurrent()
     // Get the actual current.
     motorCurrentCurrent = adc_GetCurrent();
 
+    // Update the winding temperature, and the torque limit.
+    torq_UpdateThermalModel(motorCurrentCurrent, dt);
+
     // If the H-Bridge chip is in fault, it will block the current. So, reset
     // the PID integrator and soften the PID settings, to avoid a new current
     // surge when it will resume the current. This avoid the continuous
     // "beeping" that can appear in some conditions.
     if(hb_HasFault())
     {
-        torq_currentPid.kp = KP_CURRENT_DEFAULT_VAL / 4.0f;
-        torq_currentPid.ki = KI_CURRENT_DEFAULT_VAL / 4.0f;
+        torq_currentPid.kp = torq_nominalKp / 4.0f;
+        torq_currentPid.ki = torq_nominalKi / 4.0f;
         torq_currentPid.integrator = 0.0f;
         torq_pidSoftModeTime = SOFTER_PID_DURATION;
     }
@@ -124,16 +212,38 @@ void torq_RegulateCurrent()
         if(torq_pidSoftModeTime <= 0.0f)
         {
             // Go back to the normal PID settings.
-            torq_currentPid.kp = KP_CURRENT_DEFAULT_VAL;
-            torq_currentPid.ki = KI_CURRENT_DEFAULT_VAL;
+            torq_currentPid.kp = torq_nominalKp;
+            torq_currentPid.ki = torq_nominalKi;
         }
     }
 
-    // Regulate.
-    motorVoltage = -pid_Step((pid_Pid*)&torq_currentPid,
-                             motorCurrentCurrent,
-                             torq_targetCurrent,
-                             (float32_t)cbt_GetCurrentLoopPeriod()*MICROSECOND_TO_SECOND);
+    // Start the auto-tuning, when requested by the computer.
+    if(torq_autotuneState == TORQ_AUTOTUNE_START)
+        torq_StartAutotune();
+
+    // Regulate, or identify the motor with the relay experiment.
+    if(torq_autotuneState == TORQ_AUTOTUNE_RUNNING)
+    {
+        motorVoltage = torq_AutotuneStep(adc_GetUnfilteredCurrent(), dt);
+        torq_currentPid.integrator = 0.0f; // Restart from zero afterwards.
+    }
+    else
+    {
+        motorVoltage = -pid_Step((pid_Pid*)&torq_currentPid,
+                                 motorCurrentCurrent,
+                                 torq_targetCurrent,
+                                 (float32_t)cbt_GetCurrentLoopPeriod()*MICROSECOND_TO_SECOND);
+
+        // Compensate the back-EMF of the motor, so the PID only has to
+        // regulate the resistive and inductive voltages. The velocity comes
+        // from the last estimation of the haptic controller loop.
+        if(torq_backEmfCompensation)
+            torq_backEmfVoltage = torq_backEmfConst * enc_GetLastVelocity();
+        else
+            torq_backEmfVoltage = 0.0f;
+
+        motorVoltage += torq_backEmfVoltage;
+    }
     
     // Normalize to get a signed PWM duty (between -1 and 1).
     pwmNormalizedDutyCycle = motorVoltage / H_BRIDGE_SUPPLY_VOLTAGE;
@@ -147,20 +257,249 @@ void torq_RegulateCurrent()
         hb_SetPWM(0.0f);
 }
 
+/**
+ * @brief Starts the relay experiment of the current loop auto-tuning.
+ * @remark The current regulation has to be enabled (current sensor
+ * calibrated), otherwise the auto-tuning fails immediately.
+ */
+void torq_StartAutotune(void)
+{
+    int i;
+
+    if(!torq_regulateCurrent || torq_autotuneDuration <= 0.0f ||
+       torq_autotuneRelayVoltage <= 0.0f)
+    {
+        torq_autotuneState = TORQ_AUTOTUNE_FAILED;
+        return;
+    }
+
+    for(i=0; i<5; i++)
+        torq_autotuneSums[i] = 0.0f;
+
+    torq_autotuneTime = 0.0f;
+    torq_autotuneTicks = 0;
+    torq_autotuneRelaySign = 1.0f;
+    torq_autotuneVoltages[0] = 0.0f;
+    torq_autotuneVoltages[1] = 0.0f;
+    torq_autotunePrevCurrent = 0.0f;
+    torq_autotuneProgress = 0.0f;
+    torq_autotuneState = TORQ_AUTOTUNE_RUNNING;
+}
+
+/**
+ * @brief Runs one tick of the relay experiment, and accumulates the least
+ * squares sums of the motor RL model.
+ * @param current the unfiltered motor current [A].
+ * @param dt time elapsed since the last call [s].
+ * @return the motor voltage to apply [V].
+ */
+float32_t torq_AutotuneStep(float32_t current, float32_t dt)
+{
+    float32_t voltage;
+
+    // The duty cycle computed at a tick is applied from the next tick, so the
+    // current change between the last two ticks is driven by the voltage
+    // computed two ticks ago. In the sign of the measured current, the model
+    // is -(V - Ke*w) = R*i + L*di/dt.
+    if(torq_autotuneTicks >= 2)
+    {
+        float32_t meanCurrent = 0.5f * (current + torq_autotunePrevCurrent);
+        float32_t currentSlope = (current - torq_autotunePrevCurrent) / dt;
+        float32_t resistiveVoltage = -(torq_autotuneVoltages[1]
+                                       - torq_backEmfConst * enc_GetLastVelocity());
+
+        torq_autotuneSums[0] += meanCurrent * meanCurrent;
+        torq_autotuneSums[1] += meanCurrent * currentSlope;
+        torq_autotuneSums[2] += currentSlope * currentSlope;
+        torq_autotuneSums[3] += meanCurrent * resistiveVoltage;
+        torq_autotuneSums[4] += currentSlope * resistiveVoltage;
+    }
+
+    // Relay with hysteresis. A positive voltage decreases the measured current.
+    if(current > torq_autotuneHysteresis)
+        torq_autotuneRelaySign = 1.0f;
+    else if(current < -torq_autotuneHysteresis)
+        torq_autotuneRelaySign = -1.0f;
+
+    voltage = torq_autotuneRelaySign * torq_autotuneRelayVoltage;
+
+    torq_autotuneVoltages[1] = torq_autotuneVoltages[0];
+    torq_autotuneVoltages[0] = voltage;
+    torq_autotunePrevCurrent = current;
+    torq_autotuneTicks++;
+    torq_autotuneTime += dt;
+    torq_autotuneProgress = 100.0f * torq_autotuneTime / torq_autotuneDuration;
+
+    if(torq_autotuneTime >= torq_autotuneDuration)
+    {
+        torq_FinishAutotune();
+        return 0.0f;
+    }
+    else
+        return voltage;
+}
+
+/**
+ * @brief Identifies R and L from the least squares sums, and sets the PI gains
+ * for the target bandwidth.
+ */
+void torq_FinishAutotune(void)
+{
+    float32_t *s = torq_autotuneSums;
+    float32_t det = s[0] * s[2] - s[1] * s[1];
+    float32_t resistance, inductance, omega;
+
+    torq_autotuneProgress = 100.0f;
+
+    if(det <= 0.0f)
+    {
+        torq_autotuneState = TORQ_AUTOTUNE_FAILED;
+        return;
+    }
+
+    resistance = (s[3] * s[2] - s[4] * s[1]) / det;
+    inductance = (s[4] * s[0] - s[3] * s[1]) / det;
+
+    torq_identifiedResistance = resistance;
+    torq_identifiedInductance = inductance;
+
+    if(resistance <= 0.0f || inductance <= 0.0f)
+    {
+        torq_autotuneState = TORQ_AUTOTUNE_FAILED;
+        return;
+    }
+
+    // Place the PI zero on the electrical pole R/L.
+    omega = 2.0f * (float32_t)M_PI * torq_autotuneBandwidth;
+    torq_nominalKp = omega * inductance;
+    torq_nominalKi = omega * resistance;
+    torq_currentPid.kp = torq_nominalKp;
+    torq_currentPid.ki = torq_nominalKi;
+    torq_currentPid.feedforward = resistance;
+    torq_currentPid.integrator = 0.0f;
+
+    torq_autotuneState = TORQ_AUTOTUNE_DONE;
+}
+
+/**
+ * @brief Updates the thermal model of the winding, and derates the torque
+ * limit as the winding heats up.
+ * @param current the motor current [A].
+ * @param dt time elapsed since the last call [s].
+ */
+void torq_UpdateThermalModel(float32_t current, float32_t dt)
+{
+    float32_t resistance, alpha, temperature, torqueLimit;
+    float32_t maxResistance, sustainableTorque;
+
+    // Accumulate the heat over several ticks, so the temperature increments
+    // are not lost in the float resolution.
+    resistance = MOTOR_RESISTANCE
+                 * (1.0f + COPPER_TEMPERATURE_COEF
+                           * (torq_windingTemperature - RESISTANCE_REF_TEMPERATURE));
+    torq_heatEnergy += resistance * current * current * dt;
+    torq_heatTime += dt;
+    torq_thermalTicks++;
+
+    if(torq_thermalTicks < THERMAL_MODEL_DECIMATION)
+        return;
+
+    // First-order model: the temperature tends to the ambient temperature,
+    // plus the thermal resistance times the dissipated power.
+    alpha = torq_heatTime / torq_thermalTimeConst;
+    utils_SaturateF(&alpha, 0.0f, 1.0f);
+
+    temperature = torq_windingTemperature;
+    temperature += alpha * (torq_ambientTemperature
+                            + torq_thermalResistance * torq_heatEnergy
+                              / torq_heatTime
+                            - temperature);
+    torq_windingTemperature = temperature;
+
+    torq_heatEnergy = 0.0f;
+    torq_heatTime = 0.0f;
+    torq_thermalTicks = 0;
+
+    // The sustainable torque keeps the winding at the max temperature in
+    // steady state: Kt*sqrt((Tmax-Tamb) / (Rth*R(Tmax))).
+    maxResistance = MOTOR_RESISTANCE
+                    * (1.0f + COPPER_TEMPERATURE_COEF
+                              * (torq_maxWindingTemperature - RESISTANCE_REF_TEMPERATURE));
+
+    if(torq_maxWindingTemperature > torq_ambientTemperature
+       && torq_thermalResistance > 0.0f)
+    {
+        sustainableTorque = MOTOR_TORQUE_CONST
+                            * sqrtf((torq_maxWindingTemperature - torq_ambientTemperature)
+                                    / (torq_thermalResistance * maxResistance));
+    }
+    else
+        sustainableTorque = 0.0f;
+
+    if(sustainableTorque > torq_peakTorque)
+        sustainableTorque = torq_peakTorque;
+
+    // Derate linearly from the peak torque to the sustainable torque, then
+    // hold it above the max temperature, so the winding cools down to it.
+    if(temperature <= torq_deratingTemperature)
+        torqueLimit = torq_peakTorque;
+    else if(temperature >= torq_maxWindingTemperature)
+        torqueLimit = sustainableTorque;
+    else
+    {
+        torqueLimit = torq_peakTorque + (sustainableTorque - torq_peakTorque)
+                      * (temperature - torq_deratingTemperature)
+                      / (torq_maxWindingTemperature - torq_deratingTemperature);
+    }
+
+    torq_torqueLimit = torqueLimit;
+}
+
 /**
  * @brief Sets the target motor torque.
  * @param torque target motor torque [N.m].
- * @remark The given value will be saturated to the motor torque, if larger.
+ * @remark The given value will be saturated to the torque limit of the thermal
+ * model, if larger.
  */
 void torq_SetTorque(float32_t torque)
 {
-    utils_SaturateF(&torque, -MOTOR_NOMINAL_TORQUE, MOTOR_NOMINAL_TORQUE);
+    utils_SaturateF(&torque, -torq_torqueLimit, torq_torqueLimit);
 
     torq_targetCurrent = -torque / MOTOR_TORQUE_CONST; // Invert the current sign, so that a positive target torque makes the motor spin in the defined positive direction.
 }
 
+/**
+ * @brief Gets the motor current measured by the current loop.
+ * @return the measured motor current [A].
+ */
+float32_t torq_GetCurrent(void)
+{
+    return torq_currentPid.current;
+}
+
+/**
+ * @brief Gets the max torque currently allowed by the thermal model.
+ * @return the torque limit, between the sustainable and the peak torques
+ * [N.m].
+ */
+float32_t torq_GetTorqueLimit(void)
+{
+    return torq_torqueLimit;
+}
+
+/**
+ * @brief Gets the motor torque, computed from the current measured by the
+ * current loop.
+ * @return the measured motor torque [N.m].
+ */
+float32_t torq_GetTorque(void)
+{
+    return -torq_currentPid.current * MOTOR_TORQUE_CONST; // Same sign inversion as torq_SetTorque().
+}
+
 void torq_SetCurrentLoopKp(float32_t Kp)
 {
+	torq_nominalKp = Kp;
 	torq_currentPid.kp = Kp;
 }
 
@@ -171,6 +510,7 @@ void torq_SetCurrentLoopKd(float32_t Kd)
 
 void torq_SetCurrentLoopKi(float32_t Ki)
 {
+	torq_nominalKi = Ki;
 	torq_currentPid.ki = Ki;
 }
 
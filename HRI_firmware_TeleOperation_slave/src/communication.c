@@ -21,7 +21,6 @@
 #include "drivers/incr_encoder.h"
 #include "drivers/hall.h"
 #include "drivers/uart.h"
-#include "lib/basic_filter.h"
 #include "lib/pid.h"
 #include "lib/utils.h"
 
@@ -36,6 +35,7 @@ uint8_t txBuffer[1024];
 
 #define COMM_BUFFER_SIZE 4096
 #define DEBUG_MESSAGE_BUFFER_SIZE 1024
+#define RX_DATA_BUFFER_SIZE (2 + UINT8_MAX) // Largest message: a SyncVar index and value (1+255), or the streamed vars list (2+255) [byte].
 
 uint8_t comm_packetTxBuffer[COMM_BUFFER_SIZE];
 char comm_debugMessageBuffer[DEBUG_MESSAGE_BUFFER_SIZE];
@@ -44,7 +44,7 @@ cb_CircularBuffer *comm_rxQueue;
 uint8_t rxCurrentMessageType = PC_MESSAGE_DO_NOTHING; // Current message type for RX bytes.
 uint32_t rxBytesCount; // Number of received bytes for the current message.
 uint8_t firstHalfByte; // First half of the data byte to receive.
-uint8_t rxDataBytesBuffer[32]; // Data bytes received (ready to use, bytes already merged).
+uint8_t rxDataBytesBuffer[RX_DATA_BUFFER_SIZE]; // Data bytes received (ready to use, bytes already merged).
 
 // SyncVar-related vars.
 comm_SyncVar comm_syncVars[N_SYNCVARS_MAX];
@@ -410,7 +410,11 @@ void comm_HandleByte(uint8_t rxData)
     else // Second half of the data byte has been received (or no data bytes yet).
     {
         int dataBytesReady = rxBytesCount/2;
-        rxDataBytesBuffer[dataBytesReady-1] = (firstHalfByte<<4) + (rxData & 0xf);
+
+        // The bytes past the end of the buffer are dropped, the message is
+        // then rejected because of its length.
+        if(dataBytesReady >= 1 && dataBytesReady <= RX_DATA_BUFFER_SIZE)
+            rxDataBytesBuffer[dataBytesReady-1] = (firstHalfByte<<4) + (rxData & 0xf);
         
         switch(rxCurrentMessageType)
         {
@@ -567,6 +571,14 @@ void comm_monitorVar(const char name[], void *address, comm_VarType type,
         return;
     }
     
+    // A writable variable must fit in the RX buffer, after the variable index.
+    if(access != READONLY && 1 + size > RX_DATA_BUFFER_SIZE)
+    {
+        comm_SendDebugMessage("Warning: can't add the \"%s\" SyncVar, because "
+                              "it is too large to be written.", name);
+        return;
+    }
+    
     // Trim the name if it is too long.
     if(strlen(name) > SYNCVAR_NAME_SIZE - 1)
     {
@@ -623,6 +635,14 @@ void comm_monitorVarFunc(const char name[], comm_VarType type, uint8_t size,
         return;
     }
 
+    // A writable variable must fit in the RX buffer, after the variable index.
+    if(setFunc != NULL && 1 + size > RX_DATA_BUFFER_SIZE)
+    {
+        comm_SendDebugMessage("Warning: can't add the \"%s\" SyncVar, because "
+                              "it is too large to be written.", name);
+        return;
+    }
+
     // Trim the name if it is too long.
     if(strlen(name) > SYNCVAR_NAME_SIZE - 1)
     {
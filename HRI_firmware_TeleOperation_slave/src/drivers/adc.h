@@ -18,6 +18,7 @@
 #define __ADC_H
 
 #include "../main.h"
+#include "../lib/biquad_filter.h"
 
 #define ADC_HALL_PIN GPIO_Pin_1
 #define ADC_HALL_PORT GPIOB
@@ -44,8 +45,10 @@
 #define ADC_CURRENT_SENSE_CHANNEL ADC_Channel_3
 
 #define ADC_MAX 4095.0f // Maximum value of the ADC register (2^12 - 1).
-#define ADC_MAX_CONVERSION_TIME 100 // To avoid locking if the conversion was not started properly.
-#define ADC_BUFFER_SIZE  33 // Fadc =~300kHz -> TE_ADC = 3.33us -> Average over 32 sample => usable bandwidth <10kHz
+#define ADC_N_SCANNED_CHANNELS 5 // Hall and ANIN1-4, converted in sequence by the ADC1.
+#define ADC_SCAN_PERIOD 100 // Period of the conversion of the Hall and ANIN1-4 channels [us].
+#define ADC_BUFFER_SIZE  32 // Fadc =~300kHz -> TE_ADC = 3.33us -> Average over 32 sample => usable bandwidth <10kHz
+#define ADC_BLOCK_SIZE (ADC_BUFFER_SIZE/2) // Samples summed at each half of the DMA buffer (~53us).
 #define ADC_CURRENT_SCALE (ADC_REF_VOLTAGE / (CURRENT_SHUNT_RESISTANCE * CURRENT_SHUNT_AMPLIFIER_GAIN * ADC_MAX)) // Scale between ADC increment and current [A/incr].
 #define ADC_CALIB_N_SAMPLES 1000
 
@@ -59,14 +62,25 @@
   * through the motor (useful for current regulation).
   *
   * Call adc_Init() first, in the initialization code. Then, call
-  * adc_GetChannelVoltage() every time you need the voltage.
+  * adc_GetChannelVoltage() every time you need the voltage. The ADC1 converts
+  * the Hall and ANIN1-4 channels in sequence (scan mode), triggered by TIM4
+  * every ADC_SCAN_PERIOD, and the DMA copies the results to the RAM. So,
+  * adc_GetChannelVoltage() only returns the last converted value, without
+  * waiting.
   *
   * To measure accurately the motor current, a calibration has to be performed
   * first. Call dc_CalibrateCurrentSens() in the main(), when the current
   * regulation is disabled (see H-bridge documentation). Then, call
-  * adc_GetCurrent() every time it is needed. This function returns the last
-  * value transfered by the DMA, so there is no conversion delay when calling
-  * this function.
+  * adc_GetCurrent() every time it is needed. The DMA interrupt sums each half
+  * of the circular buffer as soon as it is complete, so this function returns
+  * the average of the last ADC_BUFFER_SIZE samples without summing them, and
+  * without reading samples being overwritten. The oversampling averages out
+  * the commutation noise of the current measuring amplifier (~120 kHz).
+  * Alternatively, adc_SetSynchronousSampling() selects the current sampled in
+  * the middle of the last PWM pulse (see H_Bridge), synchronous with the
+  * current loop, for the boards where this noise is low enough. The current is
+  * low-pass filtered by a biquad filter, that can be configured at runtime
+  * through adc_GetCurrentFilter().
   *
   * @addtogroup ADC
   * @{
@@ -87,6 +101,10 @@ typedef enum
 void adc_Init(void);
 void adc_CalibrateCurrentSens(void);
 float32_t adc_GetCurrent(void); // [mA].
+float32_t adc_GetUnfilteredCurrent(void); // [A].
+bqf_Filter* adc_GetCurrentFilter(void);
+void adc_SetSynchronousSampling(bool synchronous);
+bool adc_GetSynchronousSampling(void);
 float32_t adc_GetChannelVoltage(AdcChannel channel);
 
 /**
@@ -15,6 +15,8 @@
  */
 
 #include "ext_uart.h"
+#include "callback_timers.h"
+#include "../lib/crc.h"
 #include "../lib/utils.h"
 
 #define EXUART_RX_Pin GPIO_Pin_7
@@ -33,7 +35,6 @@
 
 #define TX_BUFFER_SIZE 512
 #define RX_BUFFER_SIZE 1024
-#define USER_RX_QUEUE_SIZE 2048
 
 uint8_t exuart_txBuffer[2][TX_BUFFER_SIZE];
 uint8_t exuart_currentTxBufferToWriteTo;
@@ -43,22 +44,68 @@ uint16_t exuart_nBytesToTransferDma;
 uint8_t exuart_rxBuffer[RX_BUFFER_SIZE];
 uint8_t const * exuart_rxBuffTail;
 
-uint8_t exuart_userRxQueue[USER_RX_QUEUE_SIZE];
-cb_CircularBuffer exuart_rxQueue;
+/**
+ * @brief States of the received frames parser.
+ */
+typedef enum
+{
+    EXUART_PARSER_SYNC_0 = 0, ///< Waiting for the first byte of the sync word.
+    EXUART_PARSER_SYNC_1, ///< Waiting for the second byte of the sync word.
+    EXUART_PARSER_LENGTH, ///< Waiting for the payload length.
+    EXUART_PARSER_BODY ///< Receiving the rest of the frame, up to the CRC.
+} exuart_ParserState;
+
+/**
+ * @brief Last valid frame received from a node.
+ * The frame is kept in a double-buffered mailbox: the parser writes the new
+ * frame in the back slot, and publishes it by swapping the slots.
+ */
+typedef struct
+{
+    exuart_Frame slots[2]; ///< Front and back slots.
+    volatile uint8_t front; ///< Index of the slot readable by the user.
+    volatile bool newFrame; ///< true if the front slot was not read yet.
+    bool received; ///< true if a frame was received from this node.
+    uint8_t lastSequence; ///< Sequence number of the last valid frame received from this node.
+} exuart_Mailbox;
+
+#define EXUART_ADDRESS_SOURCE_MASK 0x0F // Bits of the source node ID, in the address byte.
+#define EXUART_ADDRESS_HOPS_SHIFT 4 // Position of the forwards count, in the address byte.
+
+exuart_ParserState exuart_parserState;
+uint16_t exuart_rxComputedCrc; // CRC of the frame being received, updated at each byte.
+uint8_t exuart_rxFrameBytes[EXUART_FRAME_MAX_SIZE]; // Raw bytes of the frame being received, kept to forward it.
+uint8_t exuart_rxFrameIndex; // Number of bytes of the frame received so far.
+uint8_t exuart_rxFrameSize; // Total size of the frame being received [byte].
+bool exuart_parserSkipping; // true while bytes are skipped to find a sync word.
+uint8_t exuart_txSequence; // Sequence number of the next frame to send.
+volatile exuart_LinkStats exuart_linkStats;
+volatile exuart_NodeConfig exuart_nodeConfig;
+uint32_t exuart_baudRate; // UART communication frequency [b/s].
+exuart_Mailbox exuart_mailboxes[EXUART_MAX_NODES];
 
 #define UART_DMA_TX_IS_BUSY (DMA_GetCmdStatus(TX_DMA) == ENABLE && DMA_GetCurrDataCounter(TX_DMA) > 0)
 
 void exuart_FlushTx(void);
+void exuart_WriteTxBuffer(uint8_t const *data, int length);
+void exuart_ParseReceivedBytes(void);
+void exuart_ParseByte(uint8_t rxByte);
+void exuart_ProcessFrame(void);
 
 /**
   * @brief Initializes the UART module.
   * @param baudRate: UART communication frequency (baud rate) [b/s].
+  * @param nodeId: ID of this board in the ring, lower than nNodes.
+  * @param nNodes: number of boards in the ring, from 2 to EXUART_MAX_NODES.
   */
-void exuart_Init(uint32_t baudRate)
+void exuart_Init(uint32_t baudRate, uint8_t nodeId, uint8_t nNodes)
 {
+    int i;
+
     GPIO_InitTypeDef GPIO_InitStruct;
     USART_InitTypeDef USART_InitStruct;   
     DMA_InitTypeDef DMA_InitStruct;
+    NVIC_InitTypeDef NVIC_InitStruct;
     
     // Enable UART and DMA peripherals clocks.
     RCC_APB2PeriphClockCmd(RCC_APB2Periph_USART1, ENABLE);
@@ -109,7 +156,7 @@ void exuart_Init(uint32_t baudRate)
     DMA_Init(RX_DMA, &DMA_InitStruct);
 
     USART_DMACmd(EXUART_PERIPH, USART_DMAReq_Rx | USART_DMAReq_Tx, ENABLE);
-    DMA_ITConfig(RX_DMA, DMA_IT_TC, ENABLE);
+    DMA_ITConfig(RX_DMA, DMA_IT_HT | DMA_IT_TC, ENABLE);
     DMA_Cmd(RX_DMA, ENABLE);
     
     exuart_rxBuffTail = &exuart_rxBuffer[0];
@@ -137,61 +184,59 @@ void exuart_Init(uint32_t baudRate)
     USART_DMACmd(EXUART_PERIPH, USART_DMAReq_Rx | USART_DMAReq_Tx, ENABLE);
     DMA_ITConfig(TX_DMA, DMA_IT_TC, ENABLE);
     
-    // Initialize the RX circular buffer.
-    cb_Init(&exuart_rxQueue, exuart_userRxQueue, USER_RX_QUEUE_SIZE);
-    
     // Initialize the variables for the UART TX.
     exuart_currentTxBufferToWriteTo = 0;
     exuart_txBufferIndex = 0;
     exuart_nBytesToTransferDma = 0;
-}
 
-/**
- * @brief Gets the number of bytes received and ready to read.
- * @return the number of bytes ready to be acquired with exuart_GetByte().
- * @remark This function must called often, otherwise the DMA RX buffer may be
- * full, and data will be lost.
- */
-uint16_t exuart_ReceivedBytesCount(void)
-{
-    // Get the location of the location currently pointed by the DMA.
-    uint8_t const * head = exuart_rxBuffer + RX_BUFFER_SIZE
-                           - DMA_GetCurrDataCounter(RX_DMA);
-                           
-    // Even if the STM32F4 reference manual (RM0090) states that the NDTR
-    // register is decremented after the transfer, this is not the case.
-    // So we wait a few cycles to be sure that the DMA actually performed the
-    // transfer.
-    utils_DelayUs(1);
-
-    // RX: add the received bytes into the user queue.
-    while(exuart_rxBuffTail != head)
+    // Initialize the frames parser and the link statistics.
+    exuart_parserState = EXUART_PARSER_SYNC_0;
+    exuart_rxComputedCrc = CRC_16_INIT;
+    exuart_rxFrameBytes[0] = EXUART_FRAME_SYNC_0;
+    exuart_rxFrameBytes[1] = EXUART_FRAME_SYNC_1;
+    exuart_rxFrameIndex = 0;
+    exuart_rxFrameSize = 0;
+    exuart_parserSkipping = false;
+    exuart_txSequence = 0;
+
+    exuart_linkStats.frames = 0;
+    exuart_linkStats.crcErrors = 0;
+    exuart_linkStats.gaps = 0;
+    exuart_linkStats.resyncs = 0;
+    exuart_linkStats.addressErrors = 0;
+    exuart_linkStats.forwarded = 0;
+
+    exuart_baudRate = baudRate;
+    exuart_nodeConfig.nodeId = 0;
+    exuart_SetNodesCount(nNodes);
+    exuart_SetNodeId(nodeId);
+
+    for(i=0; i<EXUART_MAX_NODES; i++)
     {
-        uint8_t b =  *exuart_rxBuffTail;
-        cb_Push(&exuart_rxQueue, b);
+        exuart_mailboxes[i].front = 0;
+        exuart_mailboxes[i].newFrame = false;
+        exuart_mailboxes[i].received = false;
+        exuart_mailboxes[i].lastSequence = 0;
+    }
 
-        exuart_rxBuffTail++;
+    // Parse the received bytes from the interrupts: when the line becomes idle
+    // (end of a burst of frames), and when the DMA reaches the middle or the
+    // end of the RX buffer (continuous stream).
+    USART_ITConfig(EXUART_PERIPH, USART_IT_IDLE, ENABLE);
 
-        if(exuart_rxBuffTail >= exuart_rxBuffer + RX_BUFFER_SIZE)
-            exuart_rxBuffTail -= RX_BUFFER_SIZE;
-    }
-    
-    // Return the number of bytes ready to get.
-    return cb_ItemsCount(&exuart_rxQueue);
-}
+    NVIC_InitStruct.NVIC_IRQChannel = USART1_IRQn;
+    NVIC_InitStruct.NVIC_IRQChannelPreemptionPriority = UART_RX_IRQ_PRIORIY;
+    NVIC_InitStruct.NVIC_IRQChannelSubPriority = 0;
+    NVIC_InitStruct.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_Init(&NVIC_InitStruct);
 
-/**
- * @brief Gets the next received byte.
- * @return the value of the received byte.
- * @remark call exuart_ReceivedBytesCount() before calling this function.
- * @warning this function return 0 if no byte is available.
- */
-uint8_t exuart_GetByte(void)
-{
-    if(cb_ItemsCount(&exuart_rxQueue) > 0)
-        return cb_Pull(&exuart_rxQueue);
-    else
-        return 0;
+    NVIC_InitStruct.NVIC_IRQChannel = DMA2_Stream2_IRQn;
+    NVIC_Init(&NVIC_InitStruct);
+
+    // Send the bytes written while the TX DMA was busy as soon as it is done,
+    // since the forwarded frames are not followed by another send call.
+    NVIC_InitStruct.NVIC_IRQChannel = DMA2_Stream7_IRQn;
+    NVIC_Init(&NVIC_InitStruct);
 }
 
 /**
@@ -225,6 +270,10 @@ void exuart_StartDma(void)
     DMA_InitStruct.DMA_PeripheralBurst = DMA_PeripheralBurst_Single;
     
     DMA_Init(TX_DMA, &DMA_InitStruct);
+
+    // DMA_DeInit() cleared the transfer complete interrupt, that flushes the
+    // frames forwarded during this transfer.
+    DMA_ITConfig(TX_DMA, DMA_IT_TC, ENABLE);
                           
     DMA_Cmd(TX_DMA, ENABLE);
 }
@@ -236,37 +285,33 @@ void exuart_StartDma(void)
  */
 void exuart_SendByteAsync(uint8_t data)
 {
-    // Check that it is possible to write in the current buffer.
-    if(exuart_txBufferIndex >= TX_BUFFER_SIZE)
-    {
-        // If the DMA is idle, switch to the other buffer.
-        if(UART_DMA_TX_IS_BUSY)
-        {
-            utils_TrapCpu(); // Error, can't write anywhere!
-            return;
-        }
-        else
-            exuart_StartDma();
-    }
-
-    // Write the byte in the buffer.
-    exuart_txBuffer[exuart_currentTxBufferToWriteTo][exuart_txBufferIndex] = data;
-    exuart_txBufferIndex++;
-
-    // If the buffer is full, start the DMA transfer.
-    if(exuart_txBufferIndex == TX_BUFFER_SIZE)
-        exuart_StartDma();
-    
-    //   
-    exuart_FlushTx();
+    exuart_SendBytesAsync(&data, 1);
 }
 
 /**
  * @brief Asynchronously sends the given bytes through the UART bus.
  * @param data pointer to the data bytes array to send.
  * @param length number of bytes to send (array size).
+ * @remark The interrupts are disabled while the bytes are copied to the TX
+ * buffer, since the frames are sent from the haptic controller interrupt, and
+ * forwarded from the UART RX interrupt.
  */
 void exuart_SendBytesAsync(uint8_t *data, int length)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    exuart_WriteTxBuffer(data, length);
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Writes bytes in the TX buffer, and starts the DMA if it is idle.
+ * @param data pointer to the data bytes array to send.
+ * @param length number of bytes to send (array size).
+ * @remark The interrupts that write in the TX buffer must be disabled.
+ */
+void exuart_WriteTxBuffer(uint8_t const *data, int length)
 {
     while(length > 0)
     {
@@ -315,3 +360,388 @@ void exuart_FlushTx(void)
     if(exuart_txBufferIndex > 0 && !UART_DMA_TX_IS_BUSY)
         exuart_StartDma();
 }
+
+/**
+ * @brief Asynchronously sends a frame through the UART bus.
+ * @param timestamp sender timestamp to write in the frame header [us].
+ * @param payload pointer to the payload bytes array.
+ * @param length number of payload bytes (max EXUART_FRAME_MAX_PAYLOAD_SIZE).
+ */
+void exuart_SendFrame(uint32_t timestamp, uint8_t const *payload,
+                      uint8_t length)
+{
+    uint8_t frameBytes[EXUART_FRAME_MAX_SIZE];
+    uint16_t crc;
+
+    if(length > EXUART_FRAME_MAX_PAYLOAD_SIZE)
+    {
+        utils_TrapCpu(); // Error, the payload does not fit in a frame.
+        return;
+    }
+
+    // Header.
+    frameBytes[0] = EXUART_FRAME_SYNC_0;
+    frameBytes[1] = EXUART_FRAME_SYNC_1;
+    frameBytes[2] = length;
+    frameBytes[3] = exuart_nodeConfig.nodeId & EXUART_ADDRESS_SOURCE_MASK;
+    frameBytes[4] = exuart_txSequence;
+    memcpy(&frameBytes[5], &timestamp, sizeof(timestamp));
+
+    exuart_txSequence++;
+
+    // Payload.
+    memcpy(&frameBytes[EXUART_FRAME_HEADER_SIZE], payload, length);
+
+    // CRC of everything after the sync word.
+    crc = crc_Crc16(&frameBytes[2], EXUART_FRAME_HEADER_SIZE - 2 + length);
+    frameBytes[EXUART_FRAME_HEADER_SIZE + length] = (uint8_t)(crc & 0xFF);
+    frameBytes[EXUART_FRAME_HEADER_SIZE + length + 1] = (uint8_t)(crc >> 8);
+
+    exuart_SendBytesAsync(frameBytes, EXUART_FRAME_HEADER_SIZE + length
+                                      + EXUART_FRAME_CRC_SIZE);
+}
+
+/**
+ * @brief Gets the last valid frame received from the given node.
+ * @param node ID of the node that sent the frame.
+ * @param frame the structure to fill with the received frame.
+ * @return true if a new valid frame was received from this node since the last
+ * call, and was copied to frame, false otherwise.
+ * @remark The frames are parsed in the UART interrupts, so this function
+ * executes in constant time. If several frames were received since the last
+ * call, only the most recent one is returned.
+ * @warning This function must not be called from an interrupt of lower or equal
+ * priority than UART_RX_IRQ_PRIORIY, otherwise the mailbox slot being read may
+ * be overwritten.
+ */
+bool exuart_GetLastFrame(uint8_t node, exuart_Frame *frame)
+{
+    exuart_Mailbox *mailbox;
+
+    if(node >= EXUART_MAX_NODES)
+        return false;
+
+    mailbox = &exuart_mailboxes[node];
+
+    if(!mailbox->newFrame)
+        return false;
+
+    mailbox->newFrame = false;
+    *frame = mailbox->slots[mailbox->front];
+
+    return true;
+}
+
+/**
+ * @brief Gets the link quality counters.
+ * @return a pointer to the link statistics structure.
+ */
+volatile exuart_LinkStats *exuart_GetLinkStats(void)
+{
+    return &exuart_linkStats;
+}
+
+/**
+ * @brief Gets the position of the board in the ring.
+ * @return a pointer to the node configuration structure. It should only be
+ * modified with exuart_SetNodeId() and exuart_SetNodesCount().
+ */
+volatile exuart_NodeConfig *exuart_GetNodeConfig(void)
+{
+    return &exuart_nodeConfig;
+}
+
+/**
+ * @brief Sets the ID of this board in the ring.
+ * @param nodeId the new node ID. It is ignored if it is not lower than the
+ * number of nodes.
+ */
+void exuart_SetNodeId(uint8_t nodeId)
+{
+    if(nodeId < exuart_nodeConfig.nNodes)
+        exuart_nodeConfig.nodeId = nodeId;
+}
+
+/**
+ * @brief Sets the number of boards in the ring.
+ * @param nNodes the new number of nodes, saturated between 2 and
+ * EXUART_MAX_NODES. If the node ID is not lower anymore, it is set to the last
+ * node of the ring.
+ */
+void exuart_SetNodesCount(uint8_t nNodes)
+{
+    if(nNodes < 2)
+        nNodes = 2;
+    else if(nNodes > EXUART_MAX_NODES)
+        nNodes = EXUART_MAX_NODES;
+
+    exuart_nodeConfig.nNodes = nNodes;
+
+    if(exuart_nodeConfig.nodeId >= nNodes)
+        exuart_nodeConfig.nodeId = nNodes - 1;
+}
+
+/**
+ * @brief Gets the UART communication frequency.
+ * @return the baud rate [b/s].
+ */
+uint32_t exuart_GetBaudRate(void)
+{
+    return exuart_baudRate;
+}
+
+/**
+ * @brief Gets the ID of this board in the ring.
+ * @return the node ID.
+ */
+uint8_t exuart_GetNodeId(void)
+{
+    return exuart_nodeConfig.nodeId;
+}
+
+/**
+ * @brief Gets the number of boards in the ring.
+ * @return the number of nodes.
+ */
+uint8_t exuart_GetNodesCount(void)
+{
+    return exuart_nodeConfig.nNodes;
+}
+
+/**
+ * @brief Notes that a received byte is skipped, because it is not part of a
+ * valid frame.
+ * A resynchronization is counted only at the first byte skipped.
+ */
+void exuart_SkipByte(void)
+{
+    if(!exuart_parserSkipping)
+    {
+        exuart_linkStats.resyncs++;
+        exuart_parserSkipping = true;
+    }
+}
+
+/**
+ * @brief Parses all the bytes written by the DMA in the RX buffer since the
+ * last call.
+ * @remark This function is called from the UART and DMA interrupts only, so it
+ * cannot preempt itself.
+ */
+void exuart_ParseReceivedBytes(void)
+{
+    // Get the location of the location currently pointed by the DMA.
+    // No need to wait for the NDTR register to be up-to-date here: the DMA
+    // interrupts are triggered after the transfer, and the UART IDLE interrupt
+    // one byte duration after the last transfer.
+    uint8_t const * head = exuart_rxBuffer + RX_BUFFER_SIZE
+                           - DMA_GetCurrDataCounter(RX_DMA);
+
+    if(head >= exuart_rxBuffer + RX_BUFFER_SIZE)
+        head -= RX_BUFFER_SIZE;
+
+    // Parse the bytes directly from the DMA buffer.
+    while(exuart_rxBuffTail != head)
+    {
+        exuart_ParseByte(*exuart_rxBuffTail);
+
+        exuart_rxBuffTail++;
+
+        if(exuart_rxBuffTail >= exuart_rxBuffer + RX_BUFFER_SIZE)
+            exuart_rxBuffTail -= RX_BUFFER_SIZE;
+    }
+}
+
+/**
+ * @brief Processes a received byte, to reconstruct the frames.
+ * The raw bytes of the frame are accumulated, and the frame is processed once
+ * complete.
+ * @param rxByte the received byte.
+ */
+void exuart_ParseByte(uint8_t rxByte)
+{
+    switch(exuart_parserState)
+    {
+    case EXUART_PARSER_SYNC_0:
+        if(rxByte == EXUART_FRAME_SYNC_0)
+            exuart_parserState = EXUART_PARSER_SYNC_1;
+        else
+            exuart_SkipByte();
+        break;
+
+    case EXUART_PARSER_SYNC_1:
+        if(rxByte == EXUART_FRAME_SYNC_1)
+            exuart_parserState = EXUART_PARSER_LENGTH;
+        else
+        {
+            // The previous byte was not the start of a frame. This byte may
+            // be, though.
+            exuart_SkipByte();
+
+            if(rxByte != EXUART_FRAME_SYNC_0)
+                exuart_parserState = EXUART_PARSER_SYNC_0;
+        }
+        break;
+
+    case EXUART_PARSER_LENGTH:
+        if(rxByte <= EXUART_FRAME_MAX_PAYLOAD_SIZE)
+        {
+            exuart_parserSkipping = false;
+            exuart_rxFrameBytes[2] = rxByte;
+            exuart_rxComputedCrc = crc_Crc16Update(CRC_16_INIT, rxByte);
+            exuart_rxFrameIndex = 3;
+            exuart_rxFrameSize = EXUART_FRAME_HEADER_SIZE + rxByte
+                                 + EXUART_FRAME_CRC_SIZE;
+            exuart_parserState = EXUART_PARSER_BODY;
+        }
+        else
+        {
+            exuart_SkipByte();
+            exuart_parserState = EXUART_PARSER_SYNC_0;
+        }
+        break;
+
+    case EXUART_PARSER_BODY:
+        // Header, payload or CRC byte. The CRC bytes are not included in the
+        // computed CRC.
+        if(exuart_rxFrameIndex < exuart_rxFrameSize - EXUART_FRAME_CRC_SIZE)
+            exuart_rxComputedCrc = crc_Crc16Update(exuart_rxComputedCrc, rxByte);
+
+        exuart_rxFrameBytes[exuart_rxFrameIndex] = rxByte;
+        exuart_rxFrameIndex++;
+
+        if(exuart_rxFrameIndex == exuart_rxFrameSize)
+        {
+            exuart_parserState = EXUART_PARSER_SYNC_0;
+            exuart_ProcessFrame();
+        }
+        break;
+    }
+}
+
+/**
+ * @brief Checks the frame that was just received, forwards it to the next node
+ * of the ring if needed, and publishes it in the mailbox of its sender.
+ */
+void exuart_ProcessFrame(void)
+{
+    uint32_t rxTime = cbt_GetMicroseconds();
+    uint8_t length = exuart_rxFrameBytes[2];
+    uint8_t nodeId = exuart_nodeConfig.nodeId;
+    uint8_t nNodes = exuart_nodeConfig.nNodes;
+    uint8_t source, hops;
+    uint16_t receivedCrc;
+    exuart_Mailbox *mailbox;
+    exuart_Frame *frame;
+
+    // Check the CRC.
+    receivedCrc = exuart_rxFrameBytes[EXUART_FRAME_HEADER_SIZE + length]
+                  | (((uint16_t)exuart_rxFrameBytes[EXUART_FRAME_HEADER_SIZE + length + 1]) << 8);
+
+    if(exuart_rxComputedCrc != receivedCrc)
+    {
+        exuart_linkStats.crcErrors++;
+        return;
+    }
+
+    // Check the source node. In a ring of two nodes, the frame can only come
+    // from the other one, whatever its ID.
+    source = exuart_rxFrameBytes[3] & EXUART_ADDRESS_SOURCE_MASK;
+    hops = exuart_rxFrameBytes[3] >> EXUART_ADDRESS_HOPS_SHIFT;
+
+    if(source == nodeId && nNodes <= 2)
+        source = (nodeId == 0) ? 1 : 0;
+
+    if(source == nodeId || source >= EXUART_MAX_NODES)
+    {
+        exuart_linkStats.addressErrors++;
+        return;
+    }
+
+    // Forward the frame, unless the next node is its sender. The forwards
+    // count is part of the CRC, so it has to be computed again.
+    if(hops + 2 < nNodes)
+    {
+        uint16_t crc;
+
+        exuart_rxFrameBytes[3] += 1 << EXUART_ADDRESS_HOPS_SHIFT;
+        crc = crc_Crc16(&exuart_rxFrameBytes[2],
+                        EXUART_FRAME_HEADER_SIZE - 2 + length);
+        exuart_rxFrameBytes[EXUART_FRAME_HEADER_SIZE + length] = (uint8_t)(crc & 0xFF);
+        exuart_rxFrameBytes[EXUART_FRAME_HEADER_SIZE + length + 1] = (uint8_t)(crc >> 8);
+
+        exuart_SendBytesAsync(exuart_rxFrameBytes, exuart_rxFrameSize);
+        exuart_linkStats.forwarded++;
+    }
+
+    // Update the link statistics.
+    mailbox = &exuart_mailboxes[source];
+
+    if(mailbox->received)
+    {
+        exuart_linkStats.gaps += (uint8_t)(exuart_rxFrameBytes[4]
+                                           - mailbox->lastSequence - 1);
+    }
+
+    mailbox->lastSequence = exuart_rxFrameBytes[4];
+    mailbox->received = true;
+    exuart_linkStats.frames++;
+
+    // Publish the frame.
+    frame = &mailbox->slots[!mailbox->front];
+    frame->source = source;
+    frame->hops = hops;
+    frame->sequence = exuart_rxFrameBytes[4];
+    memcpy(&frame->timestamp, &exuart_rxFrameBytes[5], sizeof(frame->timestamp));
+    frame->rxTime = rxTime;
+    frame->length = length;
+    memcpy(frame->payload, &exuart_rxFrameBytes[EXUART_FRAME_HEADER_SIZE], length);
+
+    mailbox->front = !mailbox->front;
+    mailbox->newFrame = true;
+}
+
+/**
+  * @brief Interrupt from the UART, when the RX line becomes idle.
+  */
+void USART1_IRQHandler(void)
+{
+    if(USART_GetITStatus(EXUART_PERIPH, USART_IT_IDLE) != RESET)
+    {
+        // The IDLE flag is cleared by reading SR then DR.
+        USART_ReceiveData(EXUART_PERIPH);
+
+        exuart_ParseReceivedBytes();
+    }
+}
+
+/**
+  * @brief Interrupt from the RX DMA, when the middle or the end of the RX buffer
+  * is reached.
+  */
+void DMA2_Stream2_IRQHandler(void)
+{
+    if(DMA_GetITStatus(RX_DMA, DMA_IT_HTIF2) != RESET)
+        DMA_ClearITPendingBit(RX_DMA, DMA_IT_HTIF2);
+
+    if(DMA_GetITStatus(RX_DMA, DMA_IT_TCIF2) != RESET)
+        DMA_ClearITPendingBit(RX_DMA, DMA_IT_TCIF2);
+
+    exuart_ParseReceivedBytes();
+}
+
+/**
+  * @brief Interrupt from the TX DMA, when the transfer is complete.
+  */
+void DMA2_Stream7_IRQHandler(void)
+{
+    uint32_t primask;
+
+    if(DMA_GetITStatus(TX_DMA, DMA_IT_TCIF7) != RESET)
+        DMA_ClearITPendingBit(TX_DMA, DMA_IT_TCIF7);
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    exuart_FlushTx();
+    __set_PRIMASK(primask);
+}
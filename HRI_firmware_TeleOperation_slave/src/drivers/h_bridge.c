@@ -73,17 +73,17 @@ void hb_Tim8Init(void)
     GPIO_PinAFConfig(PWM1_Port, (uint8_t)PWM1_Pin,  GPIO_AF_TIM8);
     GPIO_PinAFConfig(PWM2_Port, (uint8_t)PWM2_Pin,  GPIO_AF_TIM8);
     
-    TIM_TimeBaseStruct.TIM_Period            = PWM_TIM_PERIODE;  
+    TIM_TimeBaseStruct.TIM_Period            = PWM_TIM_CENTER_PERIODE;
     TIM_TimeBaseStruct.TIM_Prescaler         = PWM_TIM_PRESCALER;
     TIM_TimeBaseStruct.TIM_ClockDivision     = 0;
-    TIM_TimeBaseStruct.TIM_CounterMode       = TIM_CounterMode_Up;
+    TIM_TimeBaseStruct.TIM_CounterMode       = TIM_CounterMode_CenterAligned1;
     TIM_TimeBaseStruct.TIM_RepetitionCounter = 0;
     TIM_TimeBaseInit(TIM8, &TIM_TimeBaseStruct);
 
     
     TIM_OCInitStruct.TIM_OCMode      = TIM_OCMode_PWM2;
     TIM_OCInitStruct.TIM_OutputState = TIM_OutputState_Enable;
-    TIM_OCInitStruct.TIM_Pulse       = ((int16_t)(PWM_TIM_PERIODE>>1)); //50% duty cycle
+    TIM_OCInitStruct.TIM_Pulse       = ((int16_t)(PWM_TIM_CENTER_PERIODE>>1)); //50% duty cycle
     TIM_OCInitStruct.TIM_OCPolarity  = TIM_OCPolarity_Low;
     TIM_OCInitStruct.TIM_OCIdleState = TIM_OCIdleState_Set;
     TIM_OC1Init(TIM8, &TIM_OCInitStruct);
@@ -95,6 +95,16 @@ void hb_Tim8Init(void)
     TIM_OC1PreloadConfig(TIM8, TIM_OCPreload_Enable);
     TIM_OC2PreloadConfig(TIM8, TIM_OCPreload_Enable);
 
+    // The channel 4 (not wired to a pin) triggers the current sampling on the
+    // rising edge of its OC4REF, so it needs a PWM mode (OC4REF is frozen in
+    // the timing mode). In PWM mode 1, OC4REF is high while CNT < CCR4, so it
+    // rises just after the top of the counter, in the middle of the pulses,
+    // when counting down.
+    TIM_OCInitStruct.TIM_OCMode      = TIM_OCMode_PWM1;
+    TIM_OCInitStruct.TIM_OutputState = TIM_OutputState_Disable;
+    TIM_OCInitStruct.TIM_Pulse       = PWM_TIM_CENTER_PERIODE - 1;
+    TIM_OC4Init(TIM8, &TIM_OCInitStruct);
+
     // TIM8 TRGO selection.
     TIM_SelectOutputTrigger(TIM8, TIM_TRGOSource_Update);
 
@@ -146,3 +156,16 @@ bool hb_HasFault(void)
 {
     return !GPIO_ReadInputDataBit(nFAULT_Port, nFAULT_Pin);
 }
+
+/**
+  * @brief Gets the actual period of the PWM.
+  * @return the PWM period [us].
+  */
+float32_t hb_GetPwmPeriod(void)
+{
+    float32_t timerFreq = (float32_t)(SystemCoreClock / APB2_PRESCALER
+                                      * TIM_MULTIPLIER); // [Hz].
+
+    return 2.0f * (float32_t)TIM8->ARR * (float32_t)(TIM8->PSC + 1)
+           / timerFreq * 1000000.0f;
+}
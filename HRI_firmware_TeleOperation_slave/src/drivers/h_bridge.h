@@ -38,6 +38,7 @@
 #define CURRENT_SCALE_RESOL ((uint32_t)(16-PWM_RESOL_SHIFT_DWN))
 #define PWM_TIM_PERIODE     ((int16_t)(0xFFFF>>PWM_RESOL_SHIFT_DWN))
 #define PWM_TIM_PRESCALER   ((int16_t)(SystemCoreClock/APB2_PRESCALER*TIM_MULTIPLIER/PWM_FREQUENCY/PWM_TIM_PERIODE-1))
+#define PWM_TIM_CENTER_PERIODE ((int16_t)(PWM_TIM_PERIODE>>1)) // Auto-reload value, since the center-aligned counter counts up and down.
 
 /** @defgroup H_Bridge Driver / H-bridge
   * @brief Driver for the H-bridge of the motor.
@@ -49,6 +50,13 @@
   * to enable the H-bridge chip (power on), and hb_SetPWM() to set the motor
   * voltage.
   *
+  * The PWM timer (TIM8) counts up and down (center-aligned), so the pulses
+  * are centered on the top of the counter. At this instant, its channel 4
+  * triggers the ADC conversion of the motor current, which is then the mean
+  * current over the PWM period, without the ripple. The update of the timer,
+  * at the bottom of the counter, triggers the current loop (see
+  * CallbackTimers).
+  *
   * @addtogroup H_Bridge
   * @{
   */
@@ -58,6 +66,7 @@ void hb_Enable(void);
 void hb_Disable(void);
 void hb_SetPWM(float32_t ratio);
 bool hb_HasFault(void);
+float32_t hb_GetPwmPeriod(void);
 
 /**
   * @}
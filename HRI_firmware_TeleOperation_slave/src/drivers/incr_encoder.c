@@ -15,12 +15,26 @@
  */
 
 #include "incr_encoder.h"
+#include "callback_timers.h"
+#include "../lib/utils.h"
+
+#define ENC_INCREMENTS_PER_EDGE 4 // Increments between two rising edges of the channel A.
 
 void tim5InitFunc(void);
+void tim3InitFunc(void);
 void extitInitFunc(void);
 
 float32_t enc_offset; // [deg].
 
+uint32_t enc_lastCallTime; // Board clock at the last call of enc_GetVelocity() [us].
+uint16_t enc_lastTimerCount; // Timestamp timer counter at the last call of enc_GetVelocity().
+uint32_t enc_time; // Timestamp timer counter, extended to 32 bits.
+int32_t enc_lastCounter; // Encoder counter at the last call of enc_GetVelocity().
+int32_t enc_edgeCounter; // Encoder counter at the last edge.
+uint32_t enc_edgeTime; // Extended timestamp of the last edge.
+bool enc_edgeValid; // true if enc_edgeTime is known.
+float32_t enc_velocity; // [deg/s].
+
 /**
   * @brief  Initialize the incremental encoder driver.
   *
@@ -30,9 +44,19 @@ float32_t enc_offset; // [deg].
 void enc_Init(void)
 {
     tim5InitFunc(); // Setup the timer 5 to be incremented with the quadrature signal of the encoder.
+    tim3InitFunc(); // Setup the timer 3 to timestamp the edges of the encoder.
     //extitInitFunc(); // Setup interrupt for the index line of the encoder.
     
     enc_offset = 0.0f;
+
+    enc_lastCallTime = cbt_GetMicroseconds();
+    enc_lastTimerCount = (uint16_t)TIM_GetCounter(TIM3);
+    enc_time = 0;
+    enc_lastCounter = (int32_t)TIM_GetCounter(TIM5);
+    enc_edgeCounter = enc_lastCounter;
+    enc_edgeTime = 0;
+    enc_edgeValid = false;
+    enc_velocity = 0.0f;
 }
 
 /**
@@ -50,6 +74,110 @@ float32_t enc_GetPosition(void)
     return outputAngle;
 }
 
+/**
+  * @brief Gets the current motor shaft velocity, estimated from the timestamps
+  * of the encoder edges.
+  * @retval The current velocity of the motor shaft [deg/s].
+  * @note This function updates the estimator, so it should be called
+  * periodically, from a single loop.
+  */
+float32_t enc_GetVelocity(void)
+{
+    uint32_t now;
+    uint16_t timerCount;
+    int32_t counter;
+    uint16_t edgeTimerCount = 0;
+    int32_t edgeCounter = 0;
+    bool newEdge = false;
+    bool gap;
+
+    // Get the last edge captured since the previous call. The timestamp is
+    // read first (which clears the flag), so an edge between the two reads
+    // sets the flag again, and both are read again.
+    while(TIM_GetFlagStatus(TIM3, TIM_FLAG_CC1) == SET)
+    {
+        newEdge = true;
+        edgeTimerCount = (uint16_t)TIM_GetCapture1(TIM3);
+        edgeCounter = (int32_t)TIM_GetCapture1(TIM5);
+    }
+
+    // The timer is read after the captures, so the last edge is never newer
+    // than timerCount. An edge captured from now on is read at the next call.
+    now = cbt_GetMicroseconds();
+    timerCount = (uint16_t)TIM_GetCounter(TIM3);
+    counter = (int32_t)TIM_GetCounter(TIM5);
+
+    // Extend the timestamp timer to 32 bits. This is not possible if the
+    // previous call is older than the timer period.
+    gap = (now - enc_lastCallTime >= ENC_TIMESTAMP_WRAP_TIME);
+
+    if(gap)
+    {
+        enc_time += (now - enc_lastCallTime) * (ENC_TIMESTAMP_FREQ / 1000000);
+        enc_edgeValid = false;
+    }
+    else
+        enc_time += (uint16_t)(timerCount - enc_lastTimerCount);
+
+    if(newEdge && !gap)
+    {
+        uint32_t edgeTime = enc_time - (uint16_t)(timerCount - edgeTimerCount);
+
+        // Increments between the last edges of two calls, over the exact time
+        // between these edges.
+        if(enc_edgeValid && edgeTime != enc_edgeTime)
+        {
+            enc_velocity = ((float32_t)(edgeCounter - enc_edgeCounter))
+                           / ((float32_t)CODER_RESOLUTION) * 360.0f
+                           * ((float32_t)ENC_TIMESTAMP_FREQ)
+                           / ((float32_t)(edgeTime - enc_edgeTime));
+        }
+
+        enc_edgeCounter = edgeCounter;
+        enc_edgeTime = edgeTime;
+        enc_edgeValid = true;
+    }
+    else if(enc_edgeValid)
+    {
+        // No edge since the last call: the velocity is lower than one edge over
+        // the time elapsed since the last one.
+        float32_t elapsedTime = ((float32_t)(enc_time - enc_edgeTime))
+                                / ((float32_t)ENC_TIMESTAMP_FREQ); // [s].
+        float32_t maxVelocity = ((float32_t)ENC_INCREMENTS_PER_EDGE)
+                                / ((float32_t)CODER_RESOLUTION) * 360.0f
+                                / elapsedTime;
+
+        if(elapsedTime > ENC_VELOCITY_TIMEOUT)
+            enc_velocity = 0.0f;
+        else
+            utils_SaturateF(&enc_velocity, -maxVelocity, maxVelocity);
+    }
+    else if(now != enc_lastCallTime)
+    {
+        // The timestamp of the edges is unknown after a long time without
+        // call: fall back to the increments over the time between the calls.
+        enc_velocity = ((float32_t)(counter - enc_lastCounter))
+                       / ((float32_t)CODER_RESOLUTION) * 360.0f
+                       * 1000000.0f / ((float32_t)(now - enc_lastCallTime));
+    }
+
+    enc_lastCallTime = now;
+    enc_lastTimerCount = timerCount;
+    enc_lastCounter = counter;
+
+    return enc_velocity;
+}
+
+/**
+  * @brief Gets the last motor shaft velocity computed by enc_GetVelocity(),
+  * without updating the estimator. It can be called from any loop.
+  * @retval The last velocity of the motor shaft [deg/s].
+  */
+float32_t enc_GetLastVelocity(void)
+{
+    return enc_velocity;
+}
+
 /**
   * @brief Set the position offset.
   *
@@ -96,9 +224,45 @@ void tim5InitFunc(void)
     TIM_EncoderInterfaceConfig(TIM5, TIM_EncoderMode_TI12, TIM_ICPolarity_Rising, TIM_ICPolarity_Rising);
     TIM_SetCounter(TIM5, 0);
 
+    // Capture the counter on the rising edges of the channel A, and output a
+    // trigger pulse to TIM3 to timestamp them.
+    TIM_CCxCmd(TIM5, TIM_Channel_1, TIM_CCx_Enable);
+    TIM_SelectOutputTrigger(TIM5, TIM_TRGOSource_OC1);
+
     TIM_Cmd(TIM5, ENABLE);
 }
 
+/**
+  * @brief  Initialize TIM3 as a free-running counter, capturing its value on
+  *         the trigger output of TIM5 (rising edges of the encoder channel A).
+  */
+void tim3InitFunc(void)
+{
+    TIM_TimeBaseInitTypeDef TIM_TimeBaseStruct;
+    TIM_ICInitTypeDef       TIM_ICInitStruct;
+
+    RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM3, ENABLE);
+
+    TIM_TimeBaseStructInit(&TIM_TimeBaseStruct);
+    TIM_TimeBaseStruct.TIM_Prescaler     = ENC_TIMESTAMP_PRESCALER;
+    TIM_TimeBaseStruct.TIM_Period        = 0xFFFF;
+    TIM_TimeBaseStruct.TIM_ClockDivision = 0;
+    TIM_TimeBaseStruct.TIM_CounterMode   = TIM_CounterMode_Up;
+    TIM_TimeBaseInit(TIM3, &TIM_TimeBaseStruct);
+
+    TIM_SelectInputTrigger(TIM3, TIM_TS_ITR2); // ITR2 is the TRGO of TIM5.
+
+    TIM_ICInitStruct.TIM_Channel     = TIM_Channel_1;
+    TIM_ICInitStruct.TIM_ICPolarity  = TIM_ICPolarity_Rising;
+    TIM_ICInitStruct.TIM_ICSelection = TIM_ICSelection_TRC;
+    TIM_ICInitStruct.TIM_ICPrescaler = TIM_ICPSC_DIV1;
+    TIM_ICInitStruct.TIM_ICFilter    = 0;
+    TIM_ICInit(TIM3, &TIM_ICInitStruct);
+    TIM_ClearFlag(TIM3, TIM_FLAG_CC1);
+
+    TIM_Cmd(TIM3, ENABLE);
+}
+
 /**
   * @brief  Initialize interrupt from Index line of the coder 
   */
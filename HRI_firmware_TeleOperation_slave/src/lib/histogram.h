@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2021 EPFL-REHAssist (Rehabilitation and Assistive Robotics Group).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __HISTOGRAM_H
+#define __HISTOGRAM_H
+
+#include "../main.h"
+
+/** @defgroup Histogram Lib / Histogram
+  * @brief Fixed-bucket histogram, updated in constant time.
+  *
+  * This module counts the occurrences of integer values in HIST_N_BINS
+  * buckets of equal width. It is cheap enough to be updated at every tick of
+  * a control loop: hist_Add() only computes the bucket index and increments
+  * it. The values lower than the range are counted in the first bucket, and
+  * the values higher in the last bucket.
+  *
+  * The structure only contains 32-bit words, so it can be sent as-is to the
+  * computer, as a UINT32 array SyncVar: the minimum value (to be interpreted
+  * as a signed integer), the bucket width, then the counts.
+  *
+  * Create a hist_Histogram structure, and initialize it with hist_Init().
+  * Then, call hist_Add() for every new value.
+  *
+  * @ingroup Lib
+  * @addtogroup Histogram
+  * @{
+  */
+
+#define HIST_N_BINS 18 ///< Number of buckets of a histogram.
+
+/**
+ * @brief Histogram structure.
+ */
+typedef struct
+{
+    int32_t min; ///< Lower bound of the first bucket.
+    uint32_t binWidth; ///< Width of a bucket.
+    uint32_t counts[HIST_N_BINS]; ///< Number of values counted in each bucket.
+} hist_Histogram;
+
+void hist_Init(hist_Histogram *hist, int32_t min, uint32_t binWidth);
+void hist_Reset(hist_Histogram *hist);
+void hist_Add(hist_Histogram *hist, int32_t value);
+
+/**
+  * @}
+  */
+
+#endif
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2021 EPFL-REHAssist (Rehabilitation and Assistive Robotics Group).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "predictor.h"
+#include "utils.h"
+
+/**
+ * @brief Initializes a pred_Predictor structure.
+ * Until the first sample is received, pred_Step() outputs the safe value.
+ * @param pred the pred_Predictor structure to initialize.
+ * @param horizon max extrapolation duration [us].
+ * @param fadeDuration duration of the fade-out to the safe value [us]. 0 to
+ * switch instantaneously.
+ */
+void pred_Init(pred_Predictor *pred, float32_t horizon, float32_t fadeDuration)
+{
+    pred->horizon = horizon;
+    pred->fadeDuration = fadeDuration;
+    pred->slopeFilterGain = PRED_DEFAULT_SLOPE_FILTER_GAIN;
+    pred->value = 0.0f;
+    pred->slope = 0.0f;
+    pred->timestamp = 0;
+    pred->age = 0.0f;
+    pred->weight = 0.0f;
+    pred->hasSample = false;
+}
+
+/**
+ * @brief Adds a newly received sample, and updates the slope estimate.
+ * @param pred the predictor to update.
+ * @param value the new sample.
+ * @param timestamp time when the sample was taken, in the sender clock [us].
+ */
+void pred_AddSample(pred_Predictor *pred, float32_t value, uint32_t timestamp)
+{
+    // Estimate the slope by finite difference, unless the previous sample is
+    // too old to be relevant (the signal was faded out).
+    uint32_t interval = timestamp - pred->timestamp;
+
+    if(pred->hasSample && pred->weight > 0.0f && interval > 0)
+    {
+        float32_t slope = (value - pred->value) / (float32_t)interval
+                          * 1000000.0f;
+
+        pred->slope += pred->slopeFilterGain * (slope - pred->slope);
+    }
+    else
+        pred->slope = 0.0f;
+
+    pred->value = value;
+    pred->timestamp = timestamp;
+    pred->age = 0.0f;
+    pred->hasSample = true;
+}
+
+/**
+ * @brief Sets the slope of the signal, measured by the sender.
+ * This overrides the finite differences estimate, until the next call to
+ * pred_AddSample().
+ * @param pred the predictor to update.
+ * @param slope the derivative of the signal, at the last sample [unit/s].
+ */
+void pred_SetSlope(pred_Predictor *pred, float32_t slope)
+{
+    pred->slope = slope;
+}
+
+/**
+ * @brief Estimates the current value of the signal.
+ * @param pred the predictor to step.
+ * @param safeValue value to fade to, when no sample was received for longer
+ * than the horizon.
+ * @param samplingPeriod time elapsed since the last call [us].
+ * @return the estimated value of the signal.
+ */
+float32_t pred_Step(pred_Predictor *pred, float32_t safeValue,
+                    float32_t samplingPeriod)
+{
+    float32_t fadeStep, extrapolationTime, predictedValue;
+
+    if(!pred->hasSample)
+        return safeValue;
+
+    // Fade out if the last sample is too old, fade in otherwise.
+    if(pred->fadeDuration > 0.0f)
+        fadeStep = samplingPeriod / pred->fadeDuration;
+    else
+        fadeStep = 1.0f;
+
+    if(pred->age > pred->horizon)
+        pred->weight -= fadeStep;
+    else
+        pred->weight += fadeStep;
+
+    utils_SaturateF(&pred->weight, 0.0f, 1.0f);
+
+    // Extrapolate from the last sample, up to the horizon.
+    extrapolationTime = pred->age;
+    utils_SaturateF(&extrapolationTime, 0.0f, pred->horizon);
+
+    predictedValue = pred->value
+                     + pred->slope * extrapolationTime / 1000000.0f;
+
+    pred->age += samplingPeriod;
+
+    return safeValue + pred->weight * (predictedValue - safeValue);
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2021 EPFL-REHAssist (Rehabilitation and Assistive Robotics Group).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __PREDICTOR_H
+#define __PREDICTOR_H
+
+#include "../main.h"
+
+/** @defgroup Predictor Lib / Predictor
+  * @brief Extrapolation of an irregularly received signal, with fade-out.
+  *
+  * This module estimates the current value of a signal whose samples arrive
+  * late, irregularly, or not at all (e.g. the neighbour paddle state sent over
+  * the teleoperation link). Between two samples, the output is extrapolated
+  * linearly from the last sample and the slope of the signal, for at most
+  * horizon. This also upsamples the signal when it is sent at a lower rate
+  * than the predictor is stepped, as long as horizon is longer than the
+  * sampling period of the sender.
+  *
+  * If no sample is received for longer than horizon, the output fades
+  * linearly to a safe value given by the caller, in fadeDuration. When samples
+  * are received again, the output fades back in at the same rate, so it never
+  * jumps.
+  *
+  * The slope is estimated by finite differences of the samples, using the
+  * sender timestamps. If the sender also transmits the derivative of the
+  * signal, it can be given with pred_SetSlope() instead.
+  *
+  * Create a pred_Predictor structure, and initialize it with pred_Init(). Then,
+  * call pred_AddSample() for every received sample, and pred_Step() once per
+  * sampling period to get the estimated value.
+  *
+  * @ingroup Lib
+  * @addtogroup Predictor
+  * @{
+  */
+
+#define PRED_DEFAULT_SLOPE_FILTER_GAIN 0.5f ///< Default gain of the first-order filter of the slope estimate [].
+
+/**
+ * @brief Predictor structure.
+ */
+typedef struct
+{
+    float32_t horizon; ///< Max extrapolation duration, after which the output fades out [us].
+    float32_t fadeDuration; ///< Duration for the output to fade out to the safe value, or back in [us].
+    float32_t slopeFilterGain; ///< Gain of the first-order filter of the finite differences slope (0.0-1.0). 1 does not filter.
+    float32_t value; ///< Last sample received.
+    float32_t slope; ///< Estimated derivative of the signal [unit/s].
+    uint32_t timestamp; ///< Sender timestamp of the last sample [us].
+    float32_t age; ///< Time since the last sample was received [us].
+    float32_t weight; ///< Weight of the extrapolated value in the output, versus the safe value (0.0-1.0).
+    bool hasSample; ///< true if at least one sample was received.
+} pred_Predictor;
+
+void pred_Init(pred_Predictor *pred, float32_t horizon, float32_t fadeDuration);
+void pred_AddSample(pred_Predictor *pred, float32_t value, uint32_t timestamp);
+void pred_SetSlope(pred_Predictor *pred, float32_t slope);
+float32_t pred_Step(pred_Predictor *pred, float32_t safeValue,
+                    float32_t samplingPeriod);
+
+/**
+  * @}
+  */
+
+#endif
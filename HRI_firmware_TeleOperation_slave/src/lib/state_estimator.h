@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2021 EPFL-REHAssist (Rehabilitation and Assistive Robotics Group).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __STATE_ESTIMATOR_H
+#define __STATE_ESTIMATOR_H
+
+#include "../main.h"
+
+/** @defgroup StateEstimator Lib / State estimator
+  * @brief Estimation of the paddle position, velocity and acceleration, from
+  * the encoder and the Hall sensor, with consistency checks.
+  *
+  * The encoder angle is tracked by a constant-acceleration model, with the
+  * fixed (steady-state) gains of a critically damped alpha-beta-gamma filter:
+  * with theta = exp(-2*pi*bandwidth*dt), the position, velocity and
+  * acceleration are corrected by g = 1-theta^3, h/dt and 2k/dt^2 times the
+  * innovation, where h = 1.5*(1-theta)^2*(1+theta) and k = 0.5*(1-theta)^3.
+  * The gains are only recomputed when the bandwidth or the timestep change,
+  * so a step costs a few multiplications.
+  *
+  * The Hall sensor gives an absolute but noisy angle, from its voltage and a
+  * linear calibration (hallOffset, hallGain). It corrects the offset of the
+  * encoder angle with a first-order complementary filter, whose cut-off
+  * frequency is hallCorrectionCutoff (0 to disable), so the encoder gives the
+  * fast motion and the Hall sensor the absolute angle.
+  *
+  * Two residuals show the consistency of the sensors: the innovation of the
+  * encoder (encoderResidual), and the low-pass filtered difference between
+  * the Hall angle and the corrected encoder angle (hallResidual). If the
+  * latter exceeds slipThreshold, the encoder probably lost increments, and
+  * slipDetected is set until it is cleared by the user.
+  *
+  * Create a sest_Estimator structure, and initialize it with sest_Init().
+  * Then, call sest_Step() at every control tick.
+  *
+  * @ingroup Lib
+  * @addtogroup StateEstimator
+  * @{
+  */
+
+/**
+ * @brief Paddle state estimator.
+ */
+typedef struct
+{
+    float32_t bandwidth; ///< Bandwidth of the encoder tracking [Hz]. Can be modified at any time.
+    float32_t hallOffset; ///< Hall sensor voltage at the zero angle [V].
+    float32_t hallGain; ///< Hall sensor sensitivity [deg/V].
+    float32_t hallCorrectionCutoff; ///< Cut-off frequency of the encoder offset correction by the Hall angle, 0 to disable [Hz].
+    float32_t residualCutoff; ///< Cut-off frequency of the Hall residual filter [Hz].
+    float32_t slipThreshold; ///< Hall residual above which an encoder slip is detected, 0 to disable [deg].
+
+    float32_t position; ///< Estimated angle [deg].
+    float32_t velocity; ///< Estimated velocity [deg/s].
+    float32_t acceleration; ///< Estimated acceleration [deg/s^2].
+    float32_t encoderOffset; ///< Correction added to the encoder angle, from the Hall angle [deg].
+    float32_t encoderResidual; ///< Encoder angle minus the predicted angle, at the last step [deg].
+    float32_t hallResidual; ///< Filtered Hall angle minus the corrected encoder angle [deg].
+    bool slipDetected; ///< true if the Hall residual exceeded slipThreshold. Cleared by the user.
+
+    float32_t positionGain; ///< Gain g of the position correction [].
+    float32_t velocityGain; ///< Gain h/dt of the velocity correction [1/s].
+    float32_t accelerationGain; ///< Gain 2k/dt^2 of the acceleration correction [1/s^2].
+    float32_t gainsBandwidth, gainsDt; ///< Bandwidth [Hz] and timestep [s] of the cached gains.
+    bool initialized; ///< false until the first step.
+} sest_Estimator;
+
+void sest_Init(sest_Estimator *estimator, float32_t bandwidth,
+               float32_t hallOffset, float32_t hallGain);
+void sest_Step(sest_Estimator *estimator, float32_t encoderAngle,
+               float32_t hallVoltage, float32_t dt);
+
+/**
+  * @}
+  */
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2021 EPFL-REHAssist (Rehabilitation and Assistive Robotics Group).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __WAVE_VARIABLES_H
+#define __WAVE_VARIABLES_H
+
+#include "../main.h"
+#include "biquad_filter.h"
+
+/** @defgroup WaveVariables Lib / Wave variables
+  * @brief Wave transformation, to keep a delayed bilateral coupling passive.
+  *
+  * Instead of exchanging velocities and forces, the two sides of the coupling
+  * exchange wave variables, that combine both. With a wave impedance b, the
+  * side which outputs a force (impedance side, e.g. the master) sends
+  * u = (b*v + F) / sqrt(2b), and the side which outputs a velocity (admittance
+  * side, e.g. the slave) sends w = (b*v - F) / sqrt(2b). The transmitted power
+  * is then (u^2 - w^2) / 2, so the link stores energy instead of generating
+  * it, whatever the delay.
+  *
+  * A high impedance b gives a stiff but sluggish coupling, a low one gives a
+  * light but soft coupling. The incoming wave can be low-pass filtered (first
+  * order, with a bqf_Filter), which preserves the passivity, to reduce the wave
+  * reflections.
+  *
+  * Create a wave_Transform structure, and initialize it with wave_Init(). Then,
+  * at every tick, filter the received wave with wave_Filter(), and call either
+  * wave_ImpedanceStep() or wave_AdmittanceStep(), depending on the side of the
+  * coupling. Both return the wave to send to the other side. When the coupling
+  * restarts, call wave_Reset() to clear the filter.
+  *
+  * @ingroup Lib
+  * @addtogroup WaveVariables
+  * @{
+  */
+
+/**
+ * @brief Wave transformation structure.
+ */
+typedef struct
+{
+    float32_t impedance; ///< Wave impedance b [N.m/(deg/s)].
+    bqf_Filter filter; ///< Low-pass filter of the incoming wave. Its cutoff can be modified at any time, 0 to disable it [Hz].
+} wave_Transform;
+
+void wave_Init(wave_Transform *wt, float32_t impedance, float32_t filterCutoff);
+float32_t wave_Filter(wave_Transform *wt, float32_t incomingWave, float32_t dt);
+void wave_Reset(wave_Transform *wt);
+float32_t wave_ImpedanceStep(wave_Transform *wt, float32_t velocity,
+                             float32_t incomingWave, float32_t *force);
+float32_t wave_AdmittanceStep(wave_Transform *wt, float32_t force,
+                              float32_t incomingWave, float32_t *velocity);
+
+/**
+  * @}
+  */
+
+#endif
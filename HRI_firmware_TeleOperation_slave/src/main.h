@@ -47,15 +47,15 @@
  * \section stm32_resources_usage STM32's resources usage
  * \subsection stm32_resources_usage_timers Timers
  *  - TIM1: PWM of the 4 user LEDs.
- *  - TIM2: -
- *  - TIM3: -
- *  - TIM4: -
+ *  - TIM2: board clock.
+ *  - TIM3: encoder edges timestamps.
+ *  - TIM4: ADC1 conversions trigger.
  *  - TIM5: encoder quadrature decoder.
- *  - TIM6: position loop.
- *  - TIM7: variables streaming loop.
- *  - TIM8: H-bridge PWM.
+ *  - TIM6: - (its interrupt is the position loop, triggered by the current loop).
+ *  - TIM7: - (its interrupt is the variables streaming loop, triggered by the position loop).
+ *  - TIM8: H-bridge PWM, current loop and current sampling trigger.
  *  - TIM9: -
- *  - TIM10: current loop.
+ *  - TIM10: -
  *  - TIM11: -
  *  - TIM12: -
  *  - TIM13: -
@@ -104,6 +104,7 @@
 
 // Interrupt priority.
 #define CURRENT_LOOP_IRQ_PRIORITY 1 // High freq loop, should interrupt all the others.
+#define CURRENT_SENSE_IRQ_PRIORITY 1 // Sums the current samples, at the same rate as the current loop.
 #define CONTROL_LOOP_IRQ_PRIORITY 2
 #define CODER_INDEX_IRQ_PRIORITY  2 // Useless, remove?
 #define UART_RX_IRQ_PRIORIY       3
@@ -124,4 +125,10 @@
 #define MOTOR_SPEED_CONST 276.0f // [RPM/V].
 #define MOTOR_NOMINAL_TORQUE 0.032f // [N.m].
 
+// Thermal parameters (first-order model of the winding).
+#define MOTOR_THERMAL_RESISTANCE 20.0f // Winding to ambient [K/W].
+#define MOTOR_THERMAL_TIME_CONST 30.0f // [s].
+#define MOTOR_MAX_WINDING_TEMPERATURE 125.0f // [degC].
+#define AMBIENT_TEMPERATURE 25.0f // [degC].
+
 #endif
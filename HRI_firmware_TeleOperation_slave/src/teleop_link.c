@@ -0,0 +1,595 @@
+/*
+ * Copyright (C) 2021 EPFL-REHAssist (Rehabilitation and Assistive Robotics Group).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "teleop_link.h"
+#include "drivers/ext_uart.h"
+#include "drivers/callback_timers.h"
+#include "lib/utils.h"
+
+#define TLINK_SYNC_FIELDS_SIZE 7 // Target node, echoed timestamp and hold time [byte].
+#define UART_BITS_PER_BYTE 10 // Start bit, 8 data bits and stop bit.
+
+/**
+ * @brief Link state with another node of the ring.
+ */
+typedef struct
+{
+    bool frameReceived; ///< true if a frame was received from the node.
+    uint32_t lastTimestamp; ///< Timestamp of the last frame received, in the node clock [us].
+    uint32_t lastRxTime; ///< Reception time of the last frame received, in the local clock [us].
+    bool energyReceived; ///< true if a frame with the energy channel was received from the node.
+    uint32_t lastEnergyCount; ///< Energy counter of the last frame with the energy channel [LSB].
+    int32_t offsetReference; ///< Integer part of the clock offset, moved at each drift measurement [us].
+    float32_t filteredOffset; ///< Filtered clock offset, relative to offsetReference, with a sub-microsecond resolution [us].
+    float32_t filteredRoundTripTime; ///< Filtered round-trip time, with a sub-microsecond resolution [us].
+    uint32_t driftRefTime; ///< Local time of the reference point for the drift estimation [us].
+    float32_t driftRefOffset; ///< filteredOffset at the reference point for the drift estimation [us].
+    tlink_ClockSync clockSync; ///< Estimates of the node clock.
+} tlink_Node;
+
+uint8_t tlink_nFramesSinceSync; // Number of frames sent since the last clock synchronization fields.
+uint8_t tlink_syncTarget; // Node whose timestamp was echoed in the last clock synchronization fields.
+volatile tlink_Node tlink_nodes[TLINK_MAX_NODES];
+volatile tlink_Histograms tlink_histograms;
+volatile uint32_t tlink_budgetOverflows; // Number of frames sent larger than the link budget.
+
+bool tlink_ReadFrame(uint8_t node, tlink_State *state);
+bool tlink_SelectSyncTarget(void);
+int16_t tlink_Encode(float32_t value, float32_t scale);
+float32_t tlink_Decode(uint8_t const *bytes, float32_t scale);
+void tlink_ProcessClockSync(volatile tlink_Node *node, uint32_t echoedTimestamp,
+                            uint16_t holdTime, uint32_t nodeTxTime,
+                            uint32_t localRxTime, uint8_t hops);
+
+/**
+  * @brief Initializes the teleoperation link module.
+  * @remark exuart_Init() should be called before.
+  */
+void tlink_Init(void)
+{
+    int i;
+
+    tlink_nFramesSinceSync = 0;
+    tlink_syncTarget = 0;
+    tlink_budgetOverflows = 0;
+
+    for(i=0; i<TLINK_MAX_NODES; i++)
+    {
+        volatile tlink_Node *node = &tlink_nodes[i];
+
+        node->frameReceived = false;
+        node->lastTimestamp = 0;
+        node->lastRxTime = 0;
+        node->energyReceived = false;
+        node->lastEnergyCount = 0;
+        node->offsetReference = 0;
+        node->filteredOffset = 0.0f;
+        node->filteredRoundTripTime = 0.0f;
+        node->driftRefTime = 0;
+        node->driftRefOffset = 0.0f;
+
+        node->clockSync.offset = 0;
+        node->clockSync.roundTripTime = 0;
+        node->clockSync.oneWayDelay = 0;
+        node->clockSync.drift = 0.0f;
+        node->clockSync.nExchanges = 0;
+    }
+
+    hist_Init((hist_Histogram*)&tlink_histograms.roundTripTime,
+              TLINK_RTT_HIST_MIN, TLINK_RTT_HIST_BIN_WIDTH);
+    hist_Init((hist_Histogram*)&tlink_histograms.interArrivalJitter,
+              TLINK_JITTER_HIST_MIN, TLINK_JITTER_HIST_BIN_WIDTH);
+    hist_Init((hist_Histogram*)&tlink_histograms.frameAge,
+              TLINK_AGE_HIST_MIN, TLINK_AGE_HIST_BIN_WIDTH);
+}
+
+/**
+  * @brief Sends the selected channels of the paddle state to the other nodes.
+  * The frame is timestamped with the board clock.
+  * @param state the state of the paddle.
+  * @param channels bitmask of the channels to send (combination of
+  * TLINK_POSITION, TLINK_VELOCITY, TLINK_TORQUE, TLINK_CURRENT, TLINK_WAVE
+  * and TLINK_ENERGY).
+  */
+void tlink_SendState(tlink_State const *state, uint8_t channels)
+{
+    uint8_t payload[1 + 5*sizeof(int16_t) + sizeof(uint32_t)
+                    + TLINK_SYNC_FIELDS_SIZE];
+    uint8_t length = 0;
+    int16_t value;
+    uint32_t now = cbt_GetMicroseconds();
+
+    channels &= TLINK_CHANNELS_MASK;
+
+    // The frame is sent anyway, the UART DMA buffer absorbs the excess until
+    // it is full.
+    if(tlink_GetFrameSize(channels) > tlink_GetFrameBudget())
+        tlink_budgetOverflows++;
+
+    // Add the clock synchronization fields periodically, if there is a
+    // frame to reply to.
+    tlink_nFramesSinceSync++;
+
+    if(tlink_nFramesSinceSync >= TLINK_SYNC_PERIOD && tlink_SelectSyncTarget())
+    {
+        channels |= TLINK_SYNC;
+        tlink_nFramesSinceSync = 0;
+    }
+
+    payload[length++] = channels;
+
+    // The channels are written in the order of their bit.
+    if(channels & TLINK_POSITION)
+    {
+        value = tlink_Encode(state->position, TLINK_POSITION_SCALE);
+        memcpy(&payload[length], &value, sizeof(value));
+        length += sizeof(value);
+    }
+
+    if(channels & TLINK_VELOCITY)
+    {
+        value = tlink_Encode(state->velocity, TLINK_VELOCITY_SCALE);
+        memcpy(&payload[length], &value, sizeof(value));
+        length += sizeof(value);
+    }
+
+    if(channels & TLINK_TORQUE)
+    {
+        value = tlink_Encode(state->torque, TLINK_TORQUE_SCALE);
+        memcpy(&payload[length], &value, sizeof(value));
+        length += sizeof(value);
+    }
+
+    if(channels & TLINK_CURRENT)
+    {
+        value = tlink_Encode(state->current, TLINK_CURRENT_SCALE);
+        memcpy(&payload[length], &value, sizeof(value));
+        length += sizeof(value);
+    }
+
+    if(channels & TLINK_WAVE)
+    {
+        value = tlink_Encode(state->wave, TLINK_WAVE_SCALE);
+        memcpy(&payload[length], &value, sizeof(value));
+        length += sizeof(value);
+    }
+
+    if(channels & TLINK_ENERGY)
+    {
+        // The energy is never negative. The counter keeps its lowest 32 bits,
+        // the receiver unwraps it.
+        uint32_t energyCount = (uint32_t)(uint64_t)(state->energy
+                                                    * TLINK_ENERGY_SCALE);
+
+        memcpy(&payload[length], &energyCount, sizeof(energyCount));
+        length += sizeof(energyCount);
+    }
+
+    if(channels & TLINK_SYNC)
+    {
+        volatile tlink_Node *target = &tlink_nodes[tlink_syncTarget];
+        uint32_t echoedTimestamp = target->lastTimestamp;
+        uint32_t holdTime = now - target->lastRxTime;
+        uint16_t holdTime16;
+
+        utils_SaturateU(&holdTime, 0, UINT16_MAX);
+        holdTime16 = (uint16_t)holdTime;
+
+        payload[length++] = tlink_syncTarget;
+        memcpy(&payload[length], &echoedTimestamp, sizeof(echoedTimestamp));
+        length += sizeof(echoedTimestamp);
+        memcpy(&payload[length], &holdTime16, sizeof(holdTime16));
+        length += sizeof(holdTime16);
+    }
+
+    exuart_SendFrame(now, payload, length);
+}
+
+/**
+  * @brief Computes the size of a frame, on the UART link.
+  * @param channels bitmask of the channels of the frame.
+  * @return the size of the frame, with the clock synchronization fields
+  * averaged over TLINK_SYNC_PERIOD frames and rounded up [byte].
+  */
+uint8_t tlink_GetFrameSize(uint8_t channels)
+{
+    uint8_t size = EXUART_FRAME_HEADER_SIZE + EXUART_FRAME_CRC_SIZE + 1
+                   + (TLINK_SYNC_FIELDS_SIZE + TLINK_SYNC_PERIOD - 1)
+                     / TLINK_SYNC_PERIOD;
+    uint8_t bit;
+
+    for(bit = TLINK_POSITION; bit <= TLINK_WAVE; bit <<= 1)
+    {
+        if(channels & bit)
+            size += sizeof(int16_t);
+    }
+
+    if(channels & TLINK_ENERGY)
+        size += sizeof(uint32_t);
+
+    return size;
+}
+
+/**
+  * @brief Computes the number of bytes each node can send per haptic loop
+  * tick. Each link of the ring carries the frames of all the other nodes.
+  * @return the link budget of each node [byte].
+  */
+uint32_t tlink_GetFrameBudget(void)
+{
+    uint32_t bytesPerTick = (uint32_t)((uint64_t)exuart_GetBaudRate()
+                                       * cbt_GetHapticControllerPeriod()
+                                       / (UART_BITS_PER_BYTE * 1000000));
+
+    return bytesPerTick / (exuart_GetNodesCount() - 1);
+}
+
+/**
+  * @brief Gets the number of frames sent larger than the link budget.
+  * @return the number of frames over budget since the initialization.
+  */
+uint32_t tlink_GetBudgetOverflows(void)
+{
+    return tlink_budgetOverflows;
+}
+
+/**
+  * @brief Selects the next node to reply to with the clock synchronization
+  * fields, among the nodes a frame was received from.
+  * @return true if a node was selected, false if no frame was received yet.
+  */
+bool tlink_SelectSyncTarget(void)
+{
+    int i;
+
+    for(i=0; i<TLINK_MAX_NODES; i++)
+    {
+        tlink_syncTarget = (tlink_syncTarget + 1) % TLINK_MAX_NODES;
+
+        if(tlink_nodes[tlink_syncTarget].frameReceived)
+            return true;
+    }
+
+    return false;
+}
+
+/**
+  * @brief Updates the state of a node with the last frame received from it.
+  * Also records the age of the node state in the histograms, once the clocks
+  * are synchronized.
+  * @param node ID of the node.
+  * @param state the node state to update. Only the channels present in the
+  * received frame are modified, the others keep their previous value.
+  * @return true if a new valid state was received since the last call, false
+  * otherwise.
+  */
+bool tlink_GetState(uint8_t node, tlink_State *state)
+{
+    bool newState;
+
+    if(node >= TLINK_MAX_NODES)
+        return false;
+
+    newState = tlink_ReadFrame(node, state);
+
+    // The age is the time elapsed since the node sent its state, converted to
+    // the local clock: now - (timestamp - offset).
+    if(tlink_nodes[node].clockSync.nExchanges > 0)
+    {
+        uint32_t age = cbt_GetMicroseconds() - tlink_nodes[node].lastTimestamp
+                       + (uint32_t)tlink_nodes[node].clockSync.offset;
+
+        hist_Add((hist_Histogram*)&tlink_histograms.frameAge, (int32_t)age);
+    }
+
+    return newState;
+}
+
+/**
+  * @brief Gets the link quality histograms.
+  * @return a pointer to the histograms structure.
+  */
+volatile tlink_Histograms *tlink_GetHistograms(void)
+{
+    return &tlink_histograms;
+}
+
+/**
+  * @brief Decodes the last frame received from a node, if it is new and valid.
+  * @param nodeId ID of the node.
+  * @param state the node state to update.
+  * @return true if a new valid state was decoded, false otherwise.
+  */
+bool tlink_ReadFrame(uint8_t nodeId, tlink_State *state)
+{
+    volatile tlink_Node *node = &tlink_nodes[nodeId];
+    exuart_Frame frame;
+    uint8_t channels, expectedLength, i;
+    uint8_t const *bytes;
+
+    if(!exuart_GetLastFrame(nodeId, &frame) || frame.length < 1)
+        return false;
+
+    // Check that the payload size matches the channels bitmask.
+    channels = frame.payload[0];
+
+    if(channels & ~(TLINK_CHANNELS_MASK | TLINK_SYNC))
+        return false;
+
+    expectedLength = 1;
+
+    if(channels & TLINK_SYNC)
+        expectedLength += TLINK_SYNC_FIELDS_SIZE;
+
+    for(i=0; i<5; i++)
+    {
+        if(channels & (1 << i))
+            expectedLength += sizeof(int16_t);
+    }
+
+    if(channels & TLINK_ENERGY)
+        expectedLength += sizeof(uint32_t);
+
+    if(frame.length != expectedLength)
+        return false;
+
+    // The jitter compares the reception interval with the sending interval,
+    // so it does not depend on the period of the node, nor on the lost frames.
+    if(node->frameReceived)
+    {
+        int32_t jitter = (int32_t)(frame.rxTime - node->lastRxTime)
+                         - (int32_t)(frame.timestamp - node->lastTimestamp);
+
+        hist_Add((hist_Histogram*)&tlink_histograms.interArrivalJitter, jitter);
+    }
+
+    // Keep the frame timestamps, to reply with the clock synchronization
+    // fields.
+    node->lastTimestamp = frame.timestamp;
+    node->lastRxTime = frame.rxTime;
+    node->frameReceived = true;
+
+    // Decode the channels.
+    state->timestamp = frame.timestamp;
+    state->channels = channels & TLINK_CHANNELS_MASK;
+    bytes = &frame.payload[1];
+
+    if(channels & TLINK_POSITION)
+    {
+        state->position = tlink_Decode(bytes, TLINK_POSITION_SCALE);
+        bytes += sizeof(int16_t);
+    }
+
+    if(channels & TLINK_VELOCITY)
+    {
+        state->velocity = tlink_Decode(bytes, TLINK_VELOCITY_SCALE);
+        bytes += sizeof(int16_t);
+    }
+
+    if(channels & TLINK_TORQUE)
+    {
+        state->torque = tlink_Decode(bytes, TLINK_TORQUE_SCALE);
+        bytes += sizeof(int16_t);
+    }
+
+    if(channels & TLINK_CURRENT)
+    {
+        state->current = tlink_Decode(bytes, TLINK_CURRENT_SCALE);
+        bytes += sizeof(int16_t);
+    }
+
+    if(channels & TLINK_WAVE)
+    {
+        state->wave = tlink_Decode(bytes, TLINK_WAVE_SCALE);
+        bytes += sizeof(int16_t);
+    }
+
+    if(channels & TLINK_ENERGY)
+    {
+        uint32_t energyCount;
+
+        memcpy(&energyCount, bytes, sizeof(energyCount));
+        bytes += sizeof(energyCount);
+
+        // Unwrap the counter from its change since the last frame, which is
+        // much smaller than its range.
+        if(node->energyReceived)
+        {
+            state->energy += (double)(int32_t)(energyCount - node->lastEnergyCount)
+                             / TLINK_ENERGY_SCALE;
+        }
+        else
+            state->energy = (double)energyCount / TLINK_ENERGY_SCALE;
+
+        node->lastEnergyCount = energyCount;
+        node->energyReceived = true;
+    }
+
+    // Update the clock estimates, if the node replied to this one. In a ring
+    // of two nodes, it can only reply to this one, whatever the IDs.
+    if(channels & TLINK_SYNC)
+    {
+        volatile exuart_NodeConfig *nodeConfig = exuart_GetNodeConfig();
+        uint8_t target = bytes[0];
+        uint32_t echoedTimestamp;
+        uint16_t holdTime;
+
+        memcpy(&echoedTimestamp, bytes + 1, sizeof(echoedTimestamp));
+        memcpy(&holdTime, bytes + 1 + sizeof(echoedTimestamp), sizeof(holdTime));
+
+        if(target == nodeConfig->nodeId || nodeConfig->nNodes <= 2)
+        {
+            tlink_ProcessClockSync(node, echoedTimestamp, holdTime,
+                                   frame.timestamp, frame.rxTime, frame.hops);
+        }
+    }
+
+    return true;
+}
+
+/**
+  * @brief Gets the estimates of the clock of a node.
+  * @param node ID of the node, lower than TLINK_MAX_NODES.
+  * @return a pointer to the clock synchronization structure.
+  */
+volatile tlink_ClockSync *tlink_GetClockSync(uint8_t node)
+{
+    if(node >= TLINK_MAX_NODES)
+    {
+        utils_TrapCpu(); // Error, invalid node ID.
+        node = 0;
+    }
+
+    return &tlink_nodes[node].clockSync;
+}
+
+/**
+  * @brief Converts a local board clock value to the clock of a node.
+  * @param node ID of the node.
+  * @param localTime time in the local board clock [us].
+  * @return the corresponding time in the node clock [us].
+  */
+uint32_t tlink_GetNodeTime(uint8_t node, uint32_t localTime)
+{
+    if(node >= TLINK_MAX_NODES)
+        return localTime;
+
+    return localTime + (uint32_t)tlink_nodes[node].clockSync.offset;
+}
+
+/**
+  * @brief Updates the clock estimates of a node with a new timestamps
+  * exchange.
+  * The local frame was sent at t1 (local clock), received by the node at t2
+  * (node clock), which replied at t3 (node clock). The reply was received at
+  * t4 (local clock).
+  * @param node the link state with the node.
+  * @param echoedTimestamp t1, echoed by the node [us].
+  * @param holdTime t3-t2, measured by the node [us].
+  * @param nodeTxTime t3 [us].
+  * @param localRxTime t4 [us].
+  * @param hops number of forwards of the reply.
+  */
+void tlink_ProcessClockSync(volatile tlink_Node *node, uint32_t echoedTimestamp,
+                            uint16_t holdTime, uint32_t nodeTxTime,
+                            uint32_t localRxTime, uint8_t hops)
+{
+    volatile tlink_ClockSync *clockSync = &node->clockSync;
+    uint8_t nNodes = exuart_GetNodeConfig()->nNodes;
+    int32_t roundTripTime, oneWayDelay, offset;
+
+    // Compute the round-trip time. The differences are computed on unsigned
+    // integers, to handle the clock overflows.
+    roundTripTime = (int32_t)(localRxTime - echoedTimestamp) - (int32_t)holdTime;
+
+    if(roundTripTime < 0 || holdTime == UINT16_MAX)
+        return; // Inconsistent or outdated exchange, ignore it.
+
+    hist_Add((hist_Histogram*)&tlink_histograms.roundTripTime, roundTripTime);
+
+    // The reply took hops+1 of the nNodes links of the ring, and the local
+    // frame took the others. Assuming the same delay for each link, the
+    // offset is (t3-t4) + roundTripTime*(hops+1)/nNodes. With two nodes, this
+    // is the usual ((t2-t1) + (t3-t4)) / 2.
+    if(nNodes < 2 || hops + 1 >= nNodes)
+        nNodes = hops + 2;
+
+    oneWayDelay = roundTripTime * (hops + 1) / nNodes;
+    offset = (int32_t)(nodeTxTime - localRxTime) + oneWayDelay;
+
+    // Filter the estimates. The first exchange initializes them.
+    // The offset is filtered relative to an integer reference, since a float
+    // could not hold a microsecond resolution of the absolute offset after a
+    // few seconds. The round-trip time is filtered in a float as well, since
+    // an integer would not move for changes smaller than
+    // 1/TLINK_SYNC_FILTER_GAIN.
+    if(clockSync->nExchanges == 0)
+    {
+        node->offsetReference = offset;
+        node->filteredOffset = 0.0f;
+        node->filteredRoundTripTime = (float32_t)roundTripTime;
+        node->driftRefTime = localRxTime;
+        node->driftRefOffset = node->filteredOffset;
+    }
+    else
+    {
+        node->filteredOffset += TLINK_SYNC_FILTER_GAIN
+                                * ((float32_t)(offset - node->offsetReference)
+                                   - node->filteredOffset);
+        node->filteredRoundTripTime += TLINK_SYNC_FILTER_GAIN
+                                       * ((float32_t)roundTripTime
+                                          - node->filteredRoundTripTime);
+    }
+
+    clockSync->offset = node->offsetReference
+                        + (int32_t)roundf(node->filteredOffset);
+    clockSync->roundTripTime = (uint32_t)(node->filteredRoundTripTime + 0.5f);
+    clockSync->oneWayDelay = (uint32_t)(node->filteredRoundTripTime
+                                        * (float32_t)(hops + 1)
+                                        / (float32_t)nNodes + 0.5f);
+    clockSync->nExchanges++;
+
+    // Estimate the drift from the offset change over a long enough duration.
+    // Then, the whole microseconds of the filtered offset are moved to the
+    // reference, so it stays small.
+    if(localRxTime - node->driftRefTime >= TLINK_DRIFT_WINDOW)
+    {
+        float32_t drift = (node->filteredOffset - node->driftRefOffset)
+                          / (float32_t)(localRxTime - node->driftRefTime)
+                          * 1000000.0f;
+        int32_t offsetShift = (int32_t)node->filteredOffset;
+
+        clockSync->drift += TLINK_SYNC_FILTER_GAIN * (drift - clockSync->drift);
+
+        node->offsetReference += offsetShift;
+        node->filteredOffset -= (float32_t)offsetShift;
+        node->driftRefTime = localRxTime;
+        node->driftRefOffset = node->filteredOffset;
+    }
+}
+
+/**
+  * @brief Converts a physical value to a scaled 16-bit integer, saturated.
+  * @param value the value to convert.
+  * @param scale the number of LSB per unit of value.
+  * @return the scaled value.
+  */
+int16_t tlink_Encode(float32_t value, float32_t scale)
+{
+    float32_t scaled = value * scale;
+
+    if(scaled > (float32_t)INT16_MAX)
+        return INT16_MAX;
+    else if(scaled < (float32_t)INT16_MIN)
+        return INT16_MIN;
+    else
+        return (int16_t)roundf(scaled);
+}
+
+/**
+  * @brief Converts a scaled 16-bit integer back to the physical value.
+  * @param bytes pointer to the two bytes of the integer (little-endian).
+  * @param scale the number of LSB per unit of value.
+  * @return the physical value.
+  */
+float32_t tlink_Decode(uint8_t const *bytes, float32_t scale)
+{
+    int16_t value;
+
+    memcpy(&value, bytes, sizeof(value));
+
+    return ((float32_t)value) / scale;
+}
@@ -27,13 +27,44 @@
   * current sensor is calibrated. torq_SetTorque() can now be called at any time
   * to set the target torque.
   *
+  * The current PID can be tuned on the board, for the motor actually
+  * connected: setting the "current autotune" SyncVar to TORQ_AUTOTUNE_START
+  * replaces the PID by a relay, that switches the motor voltage between
+  * +/- the relay voltage, when the current leaves the hysteresis band. The
+  * resistance R and the inductance L are identified by least squares on the
+  * resulting oscillation, compensating the back-EMF, so the paddle can be
+  * blocked or free. Then, the PI gains are set to Kp = 2*pi*fc*L and
+  * Ki = 2*pi*fc*R, so the PI zero cancels the electrical pole and the
+  * closed-loop bandwidth is fc, and the feedforward to R.
+  *
+  * The torque is not limited to the nominal torque, but to a limit that
+  * depends on the winding temperature, estimated by a first-order thermal
+  * model heated by R*i^2 (the resistance increasing with the temperature).
+  * While the winding is colder than the derating temperature, peak torques
+  * several times larger than the nominal one are allowed, for short impacts.
+  * Then, the limit decreases linearly down to the sustainable torque, reached
+  * at the max winding temperature, and held above it. The sustainable torque
+  * is the one that heats the winding up to the max temperature in steady
+  * state (about 0.027 N.m with the default parameters, below the nominal
+  * torque), so the winding cannot stay above it. The model starts at the
+  * ambient temperature, so the motor is assumed to be cold at startup.
+  *
   * @addtogroup TorqueRegulator
   * @{
   */
 
+#define TORQ_AUTOTUNE_IDLE 0 ///< The current PID is not being tuned.
+#define TORQ_AUTOTUNE_START 1 ///< Set by the computer, to start the auto-tuning.
+#define TORQ_AUTOTUNE_RUNNING 2 ///< The relay experiment is in progress.
+#define TORQ_AUTOTUNE_DONE 3 ///< The PID gains have been set from the identified motor.
+#define TORQ_AUTOTUNE_FAILED 4 ///< The identification failed, the PID gains are unchanged.
+
 void torq_Init(void);
 void torq_StartCurrentLoop(void);
 void torq_SetTorque(float32_t torque);
+float32_t torq_GetCurrent(void);
+float32_t torq_GetTorque(void);
+float32_t torq_GetTorqueLimit(void);
 
 // Functions only used temporarily for tuning the current loop PID
 void torq_SetCurrentLoopKp(float32_t Kp);